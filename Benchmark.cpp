@@ -0,0 +1,355 @@
+#include "Benchmark.h"
+#include "Utils.h"
+#include "Game.h"
+#include "algif5/algif.h"
+#include "data/GIFCache.h"
+#include "data/SpritePack.h"
+#include <allegro5/allegro.h>
+#include <allegro5/allegro_primitives.h>
+#include <algorithm>
+#include <chrono>
+#include <utility>
+#include <cstdio>
+#include <cctype>
+#include <cstring>
+#include <ctime>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace BenchmarkSetting {
+	/**
+	 * @brief Every file is decoded repeatedly for at least this many seconds.
+	 */
+	constexpr double min_time_per_file = 0.2;
+	constexpr int min_runs_per_file = 3;
+	/**
+	 * @brief Directory of the startup reports. Every run also appends its totals to startup-history.jsonl there.
+	 */
+	constexpr char report_dir[] = "./bench";
+};
+
+/**
+ * @brief Collect the paths of all .gif files under the directory entry, recursively.
+ */
+static void collect_gifs(ALLEGRO_FS_ENTRY *dir, std::vector<std::string> &paths) {
+	if(!al_open_directory(dir)) return;
+	while(ALLEGRO_FS_ENTRY *entry = al_read_directory(dir)) {
+		const char *name = al_get_fs_entry_name(entry);
+		if(al_get_fs_entry_mode(entry) & ALLEGRO_FILEMODE_ISDIR) {
+			collect_gifs(entry, paths);
+		} else {
+			// Some assets have an upper case extension.
+			std::string ext = name;
+			ext = ext.substr(ext.size() < 4 ? 0 : ext.size() - 4);
+			for(char &c : ext) c = static_cast<char>(tolower(static_cast<unsigned char>(c)));
+			if(ext == ".gif") paths.emplace_back(name);
+		}
+		al_destroy_fs_entry(entry);
+	}
+	al_close_directory(dir);
+}
+
+static bool read_file(const char *path, std::vector<uint8_t> &data) {
+	ALLEGRO_FILE *file = al_fopen(path, "rb");
+	if(!file) return false;
+	int64_t size = al_fsize(file);
+	data.resize(size > 0 ? size : 0);
+	bool ok = size > 0 && al_fread(file, data.data(), data.size()) == data.size();
+	al_fclose(file);
+	return ok;
+}
+
+int bench_gif(const char *root) {
+	GAME_ASSERT(al_init(), "failed to initialize allegro.");
+	std::vector<std::string> paths;
+	ALLEGRO_FS_ENTRY *dir = al_create_fs_entry(root);
+	collect_gifs(dir, paths);
+	al_destroy_fs_entry(dir);
+	if(paths.empty()) {
+		fprintf(stderr, "no gif found under %s.\n", root);
+		return 1;
+	}
+
+	double total_time = 0, total_bytes = 0, total_pixels = 0;
+	int failed = 0;
+	std::vector<uint8_t> data;
+	printf("%10s %10s %10s  %s\n", "MB/s", "Mpixel/s", "ms/file", "file");
+	for(const std::string &path : paths) {
+		if(!read_file(path.c_str(), data)) {
+			printf("%10s %10s %10s  %s\n", "-", "-", "-", path.c_str());
+			++failed;
+			continue;
+		}
+		// Frame sizes are counted once, outside of the timing.
+		ALGIF_ANIMATION *gif = algif_load_raw_memory(data.data(), data.size());
+		if(!gif) {
+			printf("%10s %10s %10s  %s\n", "-", "-", "-", path.c_str());
+			++failed;
+			continue;
+		}
+		double pixels = 0;
+		for(int i = 0; i < gif->frames_count; ++i)
+			pixels += static_cast<double>(gif->frames[i].bitmap_8_bit->w) * gif->frames[i].bitmap_8_bit->h;
+		algif_destroy_animation(gif);
+
+		int runs = 0;
+		double start = al_get_time(), elapsed = 0;
+		while(runs < BenchmarkSetting::min_runs_per_file || elapsed < BenchmarkSetting::min_time_per_file) {
+			algif_destroy_animation(algif_load_raw_memory(data.data(), data.size()));
+			++runs;
+			elapsed = al_get_time() - start;
+		}
+		double per_run = elapsed / runs;
+		printf("%10.1f %10.1f %10.3f  %s\n", data.size() / per_run / 1e6, pixels / per_run / 1e6, per_run * 1e3, path.c_str());
+		total_time += per_run;
+		total_bytes += data.size();
+		total_pixels += pixels;
+	}
+	printf("%d files (%d failed): %.1f MB/s, %.1f Mpixel/s, %.1f ms to decode all files once.\n",
+		static_cast<int>(paths.size()), failed, total_bytes / total_time / 1e6, total_pixels / total_time / 1e6, total_time * 1e3);
+	return failed ? 1 : 0;
+}
+
+/**
+ * @brief Compare the composed and the rendered frames of one GIF.
+ * @return The index of the first frame that differs, -1 if every frame matches, or -2 if the file cannot be decoded.
+ */
+static int verify_frames(const std::vector<uint8_t> &data, int &differing_pixels) {
+	ALGIF_ANIMATION *gif = algif_load_raw_memory(data.data(), data.size());
+	if(!gif) return -2;
+	int w = gif->width, h = gif->height;
+	std::vector<uint32_t> canvas(static_cast<size_t>(w) * h), store(canvas.size());
+	int mismatch = -1;
+	for(int i = 0; i < gif->frames_count && mismatch < 0; ++i) {
+		algif_compose_frame(gif, i, canvas.data(), store.data());
+		// Every frame is rendered on a new bitmap, as the game does when the frames cannot be composed.
+		ALLEGRO_BITMAP *target = al_create_bitmap(w, h);
+		GAME_ASSERT(target != nullptr, "cannot create bitmap.");
+		al_set_target_bitmap(target);
+		al_clear_to_color(al_map_rgba(0, 0, 0, 0));
+		algif_render_frame(gif, i, 0, 0);
+		ALLEGRO_LOCKED_REGION *lr = al_lock_bitmap(target, ALLEGRO_PIXEL_FORMAT_ABGR_8888, ALLEGRO_LOCK_READONLY);
+		GAME_ASSERT(lr != nullptr, "cannot lock bitmap.");
+		differing_pixels = 0;
+		for(int y = 0; y < h; ++y) {
+			const uint32_t *row = reinterpret_cast<const uint32_t*>(static_cast<const uint8_t*>(lr->data) + static_cast<ptrdiff_t>(y) * lr->pitch);
+			for(int x = 0; x < w; ++x)
+				differing_pixels += row[x] != canvas[static_cast<size_t>(y) * w + x];
+		}
+		al_unlock_bitmap(target);
+		al_set_target_bitmap(nullptr);
+		al_destroy_bitmap(target);
+		if(differing_pixels) mismatch = i;
+	}
+	algif_destroy_animation(gif);
+	return mismatch;
+}
+
+int verify_gif(const char *root) {
+	GAME_ASSERT(al_init(), "failed to initialize allegro.");
+	GAME_ASSERT(al_init_primitives_addon(), "failed to initialize allegro primitives addon.");
+	std::vector<std::string> paths;
+	ALLEGRO_FS_ENTRY *dir = al_create_fs_entry(root);
+	collect_gifs(dir, paths);
+	al_destroy_fs_entry(dir);
+	if(paths.empty()) {
+		fprintf(stderr, "no gif found under %s.\n", root);
+		return 1;
+	}
+
+	// The same setup as the pixel by pixel path of algif_upload_frames, on bitmaps that can be read back exactly.
+	al_set_new_bitmap_flags(ALLEGRO_MEMORY_BITMAP);
+	al_set_new_bitmap_format(ALLEGRO_PIXEL_FORMAT_ABGR_8888);
+	al_set_blender(ALLEGRO_ADD, ALLEGRO_ONE, ALLEGRO_ZERO);
+	// Every expand path of algif_compose_frame is checked, not only the one this CPU would pick.
+	const std::pair<ALGIF_EXPAND_PATH, const char*> expand_paths[] = {{ALGIF_EXPAND_SCALAR, "scalar"}, {ALGIF_EXPAND_AVX2, "avx2"}};
+	int failed = 0, checked_paths = 0;
+	std::vector<uint8_t> data;
+	for(const auto &[expand_path, name] : expand_paths) {
+		if(!algif_set_expand_path(expand_path)) {
+			printf("%-10s %-7s not available on this machine.\n", "skipped", name);
+			continue;
+		}
+		++checked_paths;
+		for(const std::string &path : paths) {
+			int differing_pixels = 0;
+			int mismatch = read_file(path.c_str(), data) ? verify_frames(data, differing_pixels) : -2;
+			if(mismatch == -1) {
+				printf("%-10s %-7s %s\n", "ok", name, path.c_str());
+				continue;
+			}
+			++failed;
+			if(mismatch == -2) printf("%-10s %-7s %s\n", "unreadable", name, path.c_str());
+			else printf("%-10s %-7s %s: frame %d differs in %d pixels\n", "MISMATCH", name, path.c_str(), mismatch, differing_pixels);
+		}
+	}
+	algif_set_expand_path(ALGIF_EXPAND_AUTO);
+	printf("%d files with %d expand paths, %d failed.\n", static_cast<int>(paths.size()), checked_paths, failed);
+	return failed ? 1 : 0;
+}
+
+int bench_startup(const char *run, int lvl) {
+	if(!strcmp(run, "cold")) {
+		// The file system needs allegro, which is shut down again so that its initialization is timed as well.
+		GAME_ASSERT(al_init(), "failed to initialize allegro.");
+		GIFCache::get_instance()->clear();
+		al_uninstall_system();
+		// Otherwise the pack would serve the same GIFs as in a warm run.
+		SpritePack::get_instance()->set_enabled(false);
+	} else if(strcmp(run, "warm")) {
+		fprintf(stderr, "unknown startup run %s, expected cold or warm.\n", run);
+		return 1;
+	}
+	StartupProfile *SP = StartupProfile::get_instance();
+	SP->start();
+	Game *game = new Game();
+	game->load_level(lvl);
+	char phase[32];
+	snprintf(phase, sizeof(phase), "load level %d", lvl);
+	SP->lap(phase);
+	bool ok = SP->report(run, lvl);
+	delete game;
+	return ok ? 0 : 1;
+}
+
+double
+StartupProfile::now() {
+	return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/**
+ * @brief Enable the profile. Phases are timed from now on.
+ */
+void
+StartupProfile::start() {
+	running = true;
+	origin = last_lap = now();
+}
+
+/**
+ * @brief Record the time since the previous lap (or since start()) as a phase. Only called on the main thread.
+ */
+void
+StartupProfile::lap(const char *phase) {
+	if(!running) return;
+	double t = now();
+	phases.push_back(Entry{"phase", phase, t - last_lap});
+	last_lap = t;
+}
+
+/**
+ * @brief Record the load of one asset. Safe to call from any thread.
+ * @param kind kind of the load, e.g. "image", or "gif pack", "gif cache" and "gif decode" for a GIF served by the sprite pack, by GIFCache or decoded from its file.
+ */
+void
+StartupProfile::record(const char *kind, const std::string &name, double seconds) {
+	if(!running) return;
+	std::lock_guard<std::mutex> lock(mutex);
+	assets.push_back(Entry{kind, name, seconds});
+}
+
+/**
+ * @brief Quote a string for JSON. Paths need no more than the backslash and the quote escaped.
+ */
+static std::string json_string(const std::string &s) {
+	std::string quoted = "\"";
+	for(char c : s) {
+		if(c == '"' || c == '\\') quoted += '\\';
+		quoted += c;
+	}
+	return quoted + "\"";
+}
+
+/**
+ * @brief Write the phases and the asset loads, longest first, as startup-<run>.txt and startup-<run>.json, print the text report, and append the totals to the history.
+ * @details Asset loads happen within the phases, and GIFs are decoded on several threads, so the asset times do not add up to the phases.
+ * @return False if a report file cannot be written.
+ */
+bool
+StartupProfile::report(const char *run, int lvl) {
+	double total = now() - origin;
+	std::vector<Entry> sorted_phases = phases, sorted_assets;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		sorted_assets = assets;
+	}
+	auto longer = [](const Entry &a, const Entry &b) { return a.seconds > b.seconds; };
+	std::stable_sort(sorted_phases.begin(), sorted_phases.end(), longer);
+	std::stable_sort(sorted_assets.begin(), sorted_assets.end(), longer);
+	// Count and time of every kind of asset load.
+	std::map<std::string, std::pair<int, double>> kinds;
+	for(const Entry &e : sorted_assets) {
+		++kinds[e.kind].first;
+		kinds[e.kind].second += e.seconds;
+	}
+
+	std::string text;
+	char line[512];
+	snprintf(line, sizeof(line), "startup (%s): %.1f ms until level %d is loaded\n\n", run, total * 1e3, lvl);
+	text += line;
+	snprintf(line, sizeof(line), "%10s %6s  %s\n", "ms", "%", "phase");
+	text += line;
+	for(const Entry &e : sorted_phases) {
+		snprintf(line, sizeof(line), "%10.2f %6.1f  %s\n", e.seconds * 1e3, e.seconds / total * 100, e.name.c_str());
+		text += line;
+	}
+	snprintf(line, sizeof(line), "\n%10s %6s  %s\n", "ms", "count", "asset kind");
+	text += line;
+	std::vector<std::pair<std::string, std::pair<int, double>>> sorted_kinds(kinds.begin(), kinds.end());
+	std::stable_sort(sorted_kinds.begin(), sorted_kinds.end(), [](const auto &a, const auto &b) { return a.second.second > b.second.second; });
+	for(auto &[kind, stat] : sorted_kinds) {
+		snprintf(line, sizeof(line), "%10.2f %6d  %s\n", stat.second * 1e3, stat.first, kind.c_str());
+		text += line;
+	}
+	snprintf(line, sizeof(line), "\n%10s  %-12s  %s\n", "ms", "kind", "asset");
+	text += line;
+	for(const Entry &e : sorted_assets) {
+		snprintf(line, sizeof(line), "%10.2f  %-12s  %s\n", e.seconds * 1e3, e.kind.c_str(), e.name.c_str());
+		text += line;
+	}
+
+	std::string json = "{\n";
+	snprintf(line, sizeof(line), "  \"run\": %s,\n  \"level\": %d,\n  \"total_ms\": %.3f,\n", json_string(run).c_str(), lvl, total * 1e3);
+	json += line;
+	json += "  \"phases\": [";
+	for(size_t i = 0; i < sorted_phases.size(); ++i) {
+		const Entry &e = sorted_phases[i];
+		snprintf(line, sizeof(line), "%s\n    {\"name\": %s, \"ms\": %.3f}", i ? "," : "", json_string(e.name).c_str(), e.seconds * 1e3);
+		json += line;
+	}
+	json += "\n  ],\n  \"assets\": [";
+	for(size_t i = 0; i < sorted_assets.size(); ++i) {
+		const Entry &e = sorted_assets[i];
+		snprintf(line, sizeof(line), "%s\n    {\"kind\": %s, \"name\": %s, \"ms\": %.3f}", i ? "," : "",
+			json_string(e.kind).c_str(), json_string(e.name).c_str(), e.seconds * 1e3);
+		json += line;
+	}
+	json += "\n  ]\n}\n";
+
+	std::string history = "{\"time\": " + std::to_string(static_cast<long long>(time(nullptr)));
+	snprintf(line, sizeof(line), ", \"run\": %s, \"level\": %d, \"total_ms\": %.3f", json_string(run).c_str(), lvl, total * 1e3);
+	history += line;
+	for(auto &[kind, stat] : kinds) {
+		std::string key = kind + "_ms";
+		std::replace(key.begin(), key.end(), ' ', '_');
+		snprintf(line, sizeof(line), ", %s: %.3f", json_string(key).c_str(), stat.second * 1e3);
+		history += line;
+	}
+	history += "}\n";
+
+	fputs(text.c_str(), stdout);
+	al_make_directory(BenchmarkSetting::report_dir);
+	std::string prefix = std::string(BenchmarkSetting::report_dir) + "/startup-" + run;
+	bool ok = true;
+	auto write = [&ok](const std::string &path, const std::string &content, const char *mode) {
+		ALLEGRO_FILE *f = al_fopen(path.c_str(), mode);
+		ok &= f && al_fwrite(f, content.data(), content.size()) == content.size();
+		if(f) ok &= al_fclose(f);
+		if(!ok) fprintf(stderr, "cannot write %s.\n", path.c_str());
+	};
+	write(prefix + ".txt", text, "wb");
+	write(prefix + ".json", json, "wb");
+	write(std::string(BenchmarkSetting::report_dir) + "/startup-history.jsonl", history, "ab");
+	return ok;
+}
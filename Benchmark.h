@@ -0,0 +1,68 @@
+#ifndef BENCHMARK_H_INCLUDED
+#define BENCHMARK_H_INCLUDED
+
+#include <string>
+#include <vector>
+#include <mutex>
+
+/**
+ * @brief Measure the decoding throughput of every GIF under root.
+ * @details Files are read into memory before timing, so only the GIF parser and the LZW decoder are measured. Nothing is uploaded to the GPU and no display is needed.
+ * @return Process exit code.
+ */
+int bench_gif(const char *root);
+
+/**
+ * @brief Check that algif_compose_frame gives the same pixels as algif_render_frame for every frame of every GIF under root.
+ * @details Both run on memory bitmaps, so no display is needed. Every expand path of algif_compose_frame that this machine supports is checked in turn, scalar and AVX2. The first differing frame of every GIF is reported.
+ * @return Process exit code: 0 if every GIF matches, 1 otherwise.
+ */
+int verify_gif(const char *root);
+
+/**
+ * @brief Measure the startup of the game up to the point where a level is loaded, then write a report.
+ * @details A cold run deletes the GIF cache first and does not open the sprite pack, so every asset is decoded from its file. A warm run uses the pack if there is one, and the cache left by the previous run. The report tells which of them served every GIF.
+ * @param run "cold" or "warm". Names the report files under BenchmarkSetting::report_dir.
+ * @param lvl the level to be loaded.
+ * @return Process exit code.
+ * @see StartupProfile
+ */
+int bench_startup(const char *run, int lvl);
+
+/**
+ * @brief Timings of the startup of the game, recorded by --bench-startup.
+ * @details Game marks the end of every phase of its construction and initialization with lap(). The asset centers time every individual load with record(), which may be called from the decoding workers. Nothing is recorded unless the profile is enabled.
+ */
+class StartupProfile
+{
+public:
+	static StartupProfile *get_instance() {
+		static StartupProfile SP;
+		return &SP;
+	}
+	static double now();
+	void start();
+	void lap(const char *phase);
+	void record(const char *kind, const std::string &name, double seconds);
+	bool report(const char *run, int lvl);
+	bool enabled() const { return running; }
+private:
+	StartupProfile() {}
+	struct Entry {
+		std::string kind;
+		std::string name;
+		double seconds;
+	};
+private:
+	bool running = false;
+	double origin = 0;
+	double last_lap = 0;
+	std::vector<Entry> phases;
+	/**
+	 * @brief Individual asset loads, guarded by mutex.
+	 */
+	std::vector<Entry> assets;
+	std::mutex mutex;
+};
+
+#endif
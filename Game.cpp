@@ -5,6 +5,13 @@
 #include "data/SoundCenter.h"
 #include "data/ImageCenter.h"
 #include "data/FontCenter.h"
+#include "data/GIFCenter.h"
+#include "data/AtlasCenter.h"
+#include "data/SpritePack.h"
+#include "data/PreloadCenter.h"
+#include "data/MemoryCenter.h"
+#include "data/LOD.h"
+#include "Benchmark.h"
 #include "Player.h"
 #include "Level.h"
 //revise start
@@ -17,6 +24,7 @@
 #include <allegro5/allegro_acodec.h>
 #include <vector>
 #include <cstring>
+#include <algorithm>
 
 // fixed settings
 constexpr char game_icon_img_path[] = "./assets/image/game_icon.png";
@@ -26,14 +34,21 @@ constexpr char background_sound_path[] = "./assets/sound/BackgroundMusic.ogg";
 constexpr char menu_img_path[] = "./assets/image/menu.png";
 constexpr char end_img_path[] = "./assets/image/zombiewon.png";
 constexpr char about_img_path[] = "./assets/image/about.png";
+//! @brief Longest real time (in seconds) the simulation catches up with between two draws.
+constexpr double max_frame_time = 0.25;
 /**
  * @brief Game entry.
  * @details The function processes all allegro events and update the event state to a generic data storage (i.e. DataCenter).
- * For timer event, the game_update and game_draw function will be called if and only if the current is timer.
+ * For timer event, the elapsed real time is accumulated and game_update is called once per fixed tick (1/FPS seconds) of accumulated time, then game_draw is called once.
+ * Hence the game speed does not depend on the drawing rate: a late frame runs more ticks, and an early frame runs none.
+ * @see DataCenter::render_alpha
  */
 void
 Game::execute() {
 	DataCenter *DC = DataCenter::get_instance();
+	const double tick = 1.0 / DC->FPS;
+	double lag = 0;
+	double last_time = al_get_time();
 	// main game loop
 	bool run = true;
 	while(run) {
@@ -41,8 +56,19 @@ Game::execute() {
 		al_wait_for_event(event_queue, &event);
 		switch(event.type) {
 			case ALLEGRO_EVENT_TIMER: {
-				run &= game_update();
-				game_draw();
+				double now = al_get_time();
+				// If the game stalls for too long (e.g. the window is dragged), we drop the time instead of running a burst of ticks.
+				lag += std::min(now - last_time, max_frame_time);
+				last_time = now;
+				while(run && lag >= tick) {
+					run &= game_update();
+					lag -= tick;
+				}
+				// Objects do not move out of LEVEL state, so interpolating would only make them jitter.
+				DC->render_alpha = (state == STATE::LEVEL) ? lag / tick : 1;
+				// Skip drawing if more events are waiting, so that drawing never falls behind the input.
+				if(run && al_is_event_queue_empty(event_queue))
+					game_draw();
 				break;
 			} case ALLEGRO_EVENT_DISPLAY_CLOSE: { // stop game
 				run = false;
@@ -54,8 +80,8 @@ Game::execute() {
 				DC->key_state[event.keyboard.keycode] = false;
 				break;
 			} case ALLEGRO_EVENT_MOUSE_AXES: {
-				DC->mouse.x = event.mouse.x;
-				DC->mouse.y = event.mouse.y;
+				DC->mouse.x = event.mouse.x / DC->display_scale;
+				DC->mouse.y = event.mouse.y / DC->display_scale;
 				break;
 			} case ALLEGRO_EVENT_MOUSE_BUTTON_DOWN: {
 				DC->mouse_state[event.mouse.button] = true;
@@ -68,41 +94,131 @@ Game::execute() {
 	}
 }
 
+/**
+ * @brief Headless game entry.
+ * @details The function plays a level by calling game_update in a tight loop, without display, audio or timer. No input is given, so the result only depends on the level and the game rules.
+ * @param lvl the level to be played.
+ * @param max_ticks upper bound of the number of updates, in case the level never ends.
+ * @return Number of updates that have been simulated.
+ * @see DataCenter::headless
+ */
+int
+Game::simulate(int lvl, int max_ticks) {
+	DataCenter *DC = DataCenter::get_instance();
+	start_level = lvl;
+	debug_log("<Game> state: change to START\n");
+	state = STATE::START;
+	int ticks = 0;
+	while(ticks < max_ticks && game_update()) {
+		++ticks;
+		// The level is finished once the game goes back to the menu.
+		if(state == STATE::MENU) break;
+	}
+	printf("level %d: %s after %d ticks (HP %d, coin %d, monsters left %d)\n",
+		lvl, (DC->player->HP > 0 && state == STATE::MENU) ? "cleared" : "failed", ticks,
+		DC->player->HP, DC->player->coin,
+		DC->level->remain_monsters() + static_cast<int>(DC->monsters.size()));
+	return ticks;
+}
+
+/**
+ * @brief Run the START state of a level until its assets are loaded and its objects are reset, without waiting for the start sound.
+ * @details Used to measure the startup. The game can be executed afterwards and continues with the level.
+ * @param lvl the level to be loaded.
+ */
+void
+Game::load_level(int lvl) {
+	start_level = lvl;
+	debug_log("<Game> state: change to START\n");
+	state = STATE::START;
+	// The UI is created once the level is loaded.
+	delete ui;
+	ui = nullptr;
+	while(!ui && game_update()) {}
+}
+
 /**
  * @brief Initialize all allegro addons and the game body.
- * @details Only one timer is created since a game and all its data should be processed synchronously.
+ * @details Only one timer is created since a game and all its data should be processed synchronously. The timer triggers drawing at draw_FPS, and the simulation ticks are derived from the elapsed time.
+ * @details In headless mode only the image addon is initialized, and bitmaps are memory bitmaps. Images are not decoded, see ImageCenter::get(). No display, audio, input or timer is created.
  */
 Game::Game() {
 	DataCenter *DC = DataCenter::get_instance();
+	StartupProfile *SP = StartupProfile::get_instance();
 	GAME_ASSERT(al_init(), "failed to initialize allegro.");
+	SP->lap("al_init");
+	SpritePack::get_instance()->open(SpritePackSetting::path);
+	SP->lap("open sprite pack");
+	display = nullptr;
+	timer = nullptr;
+	event_queue = nullptr;
+	ui = nullptr;
+	start_level = 1;
+
+	if(DC->headless) {
+		GAME_ASSERT(al_init_image_addon(), "failed to initialize allegro image addon.");
+		al_set_new_bitmap_flags(ALLEGRO_MEMORY_BITMAP);
+		debug_log("Game initialized in headless mode.\n");
+		game_init();
+		return;
+	}
 
 	// initialize allegro addons
 	bool addon_init = true;
 	addon_init &= al_init_primitives_addon();
+	SP->lap("primitives addon");
 	addon_init &= al_init_font_addon();
+	SP->lap("font addon");
 	addon_init &= al_init_ttf_addon();
+	SP->lap("ttf addon");
 	addon_init &= al_init_image_addon();
+	SP->lap("image addon");
 	addon_init &= al_init_acodec_addon();
+	SP->lap("acodec addon");
 	GAME_ASSERT(addon_init, "failed to initialize allegro addons.");
 
 	// initialize events
 	bool event_init = true;
 	event_init &= al_install_keyboard();
 	event_init &= al_install_mouse();
+	SP->lap("keyboard and mouse");
 	event_init &= al_install_audio();
+	SP->lap("audio");
 	GAME_ASSERT(event_init, "failed to initialize allegro events.");
 
 	// initialize game body
+	GAME_ASSERT(DC->display_scale > 0, "invalid display scale: %f.", DC->display_scale);
+	ALLEGRO_MONITOR_INFO monitor;
+	if(al_get_monitor_info(0, &monitor)) {
+		double fit = std::min(
+			static_cast<double>(monitor.x2 - monitor.x1) / DC->window_width,
+			static_cast<double>(monitor.y2 - monitor.y1) / DC->window_height);
+		DC->display_scale = std::min(DC->display_scale, fit);
+	}
+	DC->lod = LOD::level_for_scale(DC->display_scale);
+	if(DC->display_scale != 1)
+		al_set_new_bitmap_flags(ALLEGRO_MIN_LINEAR | ALLEGRO_MAG_LINEAR);
 	GAME_ASSERT(
-		display = al_create_display(DC->window_width, DC->window_height),
+		display = al_create_display(DC->window_width * DC->display_scale, DC->window_height * DC->display_scale),
 		"failed to create display.");
+	// Everything is laid out in window coordinates and scaled to the display here.
+	ALLEGRO_TRANSFORM transform;
+	al_identity_transform(&transform);
+	al_scale_transform(&transform, DC->display_scale, DC->display_scale);
+	al_use_transform(&transform);
+	debug_log("<Game> display scale %.2f, sprite LOD %d.\n", DC->display_scale, DC->lod);
+	SP->lap("create display");
 	GAME_ASSERT(
-		timer = al_create_timer(1.0 / DC->FPS),
+		timer = al_create_timer(1.0 / DC->draw_FPS),
 		"failed to create timer.");
 	GAME_ASSERT(
 		event_queue = al_create_event_queue(),
 		"failed to create event queue.");
 
+	// Sprites loaded from now on are packed into the atlas of this display.
+	AtlasCenter::get_instance()->init();
+	SP->lap("timer, event queue and atlas");
+
 	debug_log("Game initialized.\n");
 	game_init();
 }
@@ -116,9 +232,21 @@ Game::game_init() {
 	SoundCenter *SC = SoundCenter::get_instance();
 	ImageCenter *IC = ImageCenter::get_instance();
 	FontCenter *FC = FontCenter::get_instance();
+	StartupProfile *SP = StartupProfile::get_instance();
+	// Headless mode has nothing to draw, so the game goes straight to the level.
+	if(DC->headless) {
+		debug_log("Game state: change to START\n");
+		state = STATE::START;
+		return;
+	}
+	// The bitmaps of the menus are kept by Game, so they must never be evicted.
+	MemoryCenter *MC = MemoryCenter::get_instance();
+	for(const char *path : {game_icon_img_path, menu_img_path, background_img_path, end_img_path, about_img_path})
+		MC->pin(AssetKind::IMAGE, path);
 	// set window icon
 	game_icon = IC->get(game_icon_img_path);
 	al_set_display_icon(display, game_icon);
+	SP->lap("window icon");
 
 	// register events to event_queue
     al_register_event_source(event_queue, al_get_display_event_source(display));
@@ -128,9 +256,11 @@ Game::game_init() {
 
 	// init sound setting
 	SC->init();
+	SP->lap("SoundCenter::init");
 
 	// init font setting
 	FC->init();
+	SP->lap("FontCenter::init");
 	
 	startpage = IC->get(menu_img_path);
 	debug_log("Game state: change to MENU\n");
@@ -140,6 +270,7 @@ Game::game_init() {
 	background = IC->get(background_img_path);
 	endword = IC->get(end_img_path);
 	about = IC->get(about_img_path);
+	SP->lap("menu images");
 	/*
 	debug_log("Game state: change to START\n");
 	state = STATE::START;
@@ -159,7 +290,14 @@ Game::game_update() {
 	OperationCenter *OC = OperationCenter::get_instance();
 	SoundCenter *SC = SoundCenter::get_instance();
 	FontCenter *FC = FontCenter::get_instance();
-	static ALLEGRO_SAMPLE_INSTANCE *background = nullptr;
+	GIFCenter *GIFC = GIFCenter::get_instance();
+	PreloadCenter *PC = PreloadCenter::get_instance();
+	MemoryCenter *MC = MemoryCenter::get_instance();
+
+	// Load the assets of the level within the frame budget, and the GIFs that were missing from its manifest afterwards.
+	PC->update();
+	// Evict the assets that have not been used for a while if the memory budget is exceeded.
+	MC->update();
 
 	switch(state) {
 		case STATE::MENU: {
@@ -195,9 +333,18 @@ Game::game_update() {
 		}
 		case STATE::START: {
 			static bool is_played = false;
-			static ALLEGRO_SAMPLE_INSTANCE *instance = nullptr;
+			static bool is_loaded = false;
+			static SoundHandle instance = 0;
 			if(!is_played) {
 				instance = SC->play(game_start_sound_path, ALLEGRO_PLAYMODE_ONCE);
+				// The assets stream in while the start sound plays. Headless mode loads them at once, so that the simulation does not depend on the loading time.
+				GIFC->set_blocking(true);
+				PC->start(start_level);
+				if(DC->headless) PC->finish();
+				is_played = true;
+				is_loaded = false;
+			}
+			if(!is_loaded && PC->done()) {
 				delete ui; 
 				ui = new UI();
 				ui->init();
@@ -205,28 +352,30 @@ Game::game_update() {
 				for(int i = 0; i<5; i++)
 					DC->heros[i]->init(i*100+100);
 				debug_log("DataCenter has been reset.\n");
-				DC->level->load_level(1);
+				DC->level->load_level(start_level);
 				
 				end = false;
 				end_screen_timer = 0;
 				debug_log("<Game> All resources have been reset.\n");
-				is_played = true;
+				is_loaded = true;
 			}
-			if(!SC->is_playing(instance)) {
+			if(is_loaded && !SC->is_playing(instance)) {
 				debug_log("<Game> state: change to LEVEL\n");
 				state = STATE::LEVEL;
 				is_played = false;
+				// Everything the level uses is loaded, so a GIF that is still missing must not stall a frame.
+				GIFC->set_blocking(DC->headless);
 			}
 			break;
 		} case STATE::LEVEL: {
 			static bool BGM_played = false;
 			if(!BGM_played) {
-				background = SC->play(background_sound_path, ALLEGRO_PLAYMODE_LOOP);
+				SC->play_music(background_sound_path);
 				BGM_played = true;
 			}
 
 			if(DC->key_state[ALLEGRO_KEY_P] && !DC->prev_key_state[ALLEGRO_KEY_P]) {
-				SC->toggle_playing(background);
+				SC->toggle_music();
 				debug_log("<Game> state: change to PAUSE\n");
 				state = STATE::PAUSE;
 			}
@@ -249,7 +398,7 @@ Game::game_update() {
 			break;
 		} case STATE::PAUSE: {
 			if(DC->key_state[ALLEGRO_KEY_P] && !DC->prev_key_state[ALLEGRO_KEY_P]) {
-				SC->toggle_playing(background);
+				SC->toggle_music();
 				debug_log("<Game> state: change to LEVEL\n");
 				state = STATE::LEVEL;
 			}
@@ -294,14 +443,14 @@ Game::game_draw() {
 	if(state != STATE::END) {
 		// background
 		if(state == STATE:: MENU){
-			al_draw_bitmap(startpage, 0, 0, 0);
+			LOD::draw(startpage, 0, 0, 0);
 		}
 		else if(state == STATE:: ABOUT){
 			//al_draw_filled_rectangle(0, 0, DC->window_width, DC->window_height, al_map_rgba(255, 255, 255, 64));
-			al_draw_bitmap(about, 0, 0, 0);
+			LOD::draw(about, 0, 0, 0);
 		}
 		else {
-			al_draw_bitmap(background, 0, 0, 0);
+			LOD::draw(background, 0, 0, 0);
 		}
 		
 		/* revise
@@ -339,10 +488,15 @@ Game::game_draw() {
 			break;
 		}
 		case STATE::START: {
+			// loading bar
+			al_draw_filled_rectangle(
+				DC->window_width / 4., DC->window_height - 40,
+				DC->window_width / 4. + DC->window_width / 2. * PreloadCenter::get_instance()->progress(), DC->window_height - 30,
+				al_map_rgb(255, 255, 255));
 		} case STATE::LEVEL: {
 			if(end){
 			al_draw_filled_rectangle(0, 0, DC->window_width, DC->window_height, al_map_rgba(50, 50, 50, 64));
-			al_draw_bitmap(endword, 400, 100, 0);
+			LOD::draw(endword, 400, 100, 0);
 		}
 			break;
 		} case STATE::PAUSE: {
@@ -362,10 +516,9 @@ Game::game_draw() {
 Game::~Game() {
 	DataCenter *DC = DataCenter::get_instance();
     delete ui;
-    for (int i = 0; i < 5; i++) {
-        delete DC->heros[i];
-    }
+    // Heros are owned and deleted by DataCenter.
 
+    if(DC->headless) return;
     al_destroy_display(display);
     al_destroy_timer(timer);
     al_destroy_event_queue(event_queue);
@@ -12,6 +12,8 @@ class Game
 {
 public:
 	void execute();
+	int simulate(int lvl, int max_ticks);
+	void load_level(int lvl);
 public:
 	Game();
 	~Game();
@@ -34,6 +36,10 @@ private:
 		END
 	};
 	STATE state;
+	/**
+	 * @brief The level to be loaded when the game enters START state.
+	 */
+	int start_level;
 	ALLEGRO_EVENT event;
 	ALLEGRO_BITMAP *game_icon;
 	ALLEGRO_BITMAP *background;
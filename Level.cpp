@@ -3,10 +3,14 @@
 #include "Utils.h"
 #include "monsters/Monster.h"
 #include "data/DataCenter.h"
+#include <allegro5/allegro.h>
 #include <allegro5/allegro_primitives.h>
 #include "shapes/Point.h"
 #include "shapes/Rectangle.h"
 #include <array>
+#include <algorithm>
+#include <cmath>
+#include <sstream>
 
 using namespace std;
 
@@ -18,7 +22,11 @@ namespace LevelSetting {
 	constexpr array<int, 4> grid_size = {
 		100, 100, 100, 100
 	};
-	constexpr int monster_spawn_rate = 800;
+	//! @brief Distance between the top of the window and the first row of the grid.
+	constexpr int grid_top = 25;
+	//! @brief Delay before the first monster and period between monsters, in seconds.
+	constexpr double first_spawn_delay = 3.0;
+	constexpr double monster_spawn_period = 800 / 60.;
 };
 
 void
@@ -26,7 +34,7 @@ Level::init() {
 	level = -1;
 	grid_w = -1;
 	grid_h = -1;
-	monster_spawn_counter = 0;
+	monster_spawn_counter = -1;
 	srand(time(NULL));
 }
 
@@ -37,6 +45,7 @@ Level::init() {
  *          * Total number of monsters.
  *          * Number of each different number of monsters. The order and number follows the definition of MonsterType.
  *          * Indefinite number of Point (x, y), represented in grid format.
+ * @details The file is opened with al_fopen, so it is read from the sprite pack when the pack has it.
  * @see level_path_format
  * @see MonsterType
  */
@@ -46,25 +55,31 @@ Level::load_level(int lvl) {
 
 	char buffer[50];
 	sprintf(buffer, LevelSetting::level_path_format, lvl);
-	FILE *f = fopen(buffer, "r");
+	ALLEGRO_FILE *f = al_fopen(buffer, "rb");
 	GAME_ASSERT(f != nullptr, "cannot find level.");
+	string text;
+	char chunk[256];
+	while(size_t n = al_fread(f, chunk, sizeof(chunk))) text.append(chunk, n);
+	al_fclose(f);
+	istringstream in(text);
 	level = lvl;
 	grid_w = DC->game_field_length / LevelSetting::grid_size[lvl];
 	//grid_h = DC->game_field_length / LevelSetting::grid_size[lvl];
 	grid_h = 6;
 	num_of_monsters.clear();
 	road_path.clear();
+	Monster::load_animations();
 
 	int num;
 	// read total number of monsters & number of each monsters
-	fscanf(f, "%d", &num);
+	in >> num;
 	for(size_t i = 0; i < static_cast<size_t>(MonsterType::MONSTERTYPE_MAX); ++i) {
-		fscanf(f, "%d", &num);
+		in >> num;
 		num_of_monsters.emplace_back(num);
 	}
 
 	// read road path
-	while(fscanf(f, "%d", &num) != EOF) {
+	while(in >> num) {
 		int w = num % grid_w;
 		int h = num / grid_h;
 		road_path.emplace_back(w, h);
@@ -77,8 +92,9 @@ Level::load_level(int lvl) {
 */
 void
 Level::update() {
-	if(monster_spawn_counter<0 || monster_spawn_counter>2000) {
-		monster_spawn_counter = 180;
+	DataCenter *DC = DataCenter::get_instance();
+	if(monster_spawn_counter < 0) {
+		monster_spawn_counter = std::max(1, static_cast<int>(std::lround(LevelSetting::first_spawn_delay * DC->FPS)));
 		return;
 	}
 	if(monster_spawn_counter) {
@@ -86,11 +102,10 @@ Level::update() {
 		return;
 	}
 	//debug_log("<level> monster_spawn %d\n", monster_spawn_counter);
-	DataCenter *DC = DataCenter::get_instance();
 	/* revise
 	for(size_t i = 0; i < num_of_monsters.size(); ++i) {
 		if(num_of_monsters[i] == 0) continue;
-		DC->monsters.emplace_back(Monster::create_monster(static_cast<MonsterType>(i), DC->level->get_road_path()));
+		Monster::create_monster(static_cast<MonsterType>(i), DC->level->get_road_path());
 		num_of_monsters[i]--;
 		break;
 	}*/
@@ -101,12 +116,12 @@ Level::update() {
         vector<Point> monster_path = generate_right_to_left_path();
 
         // 創建怪物並分配路徑
-        DC->monsters.emplace_back(Monster::create_monster(static_cast<MonsterType>(i), monster_path));
+        Monster::create_monster(static_cast<MonsterType>(i), monster_path);
         num_of_monsters[i]--;
         break;
     }
 	//revise end
-	monster_spawn_counter = LevelSetting::monster_spawn_rate;
+	monster_spawn_counter = std::max(1, static_cast<int>(std::lround(LevelSetting::monster_spawn_period * DC->FPS)));
 }
 
 void
@@ -114,7 +129,7 @@ Level::draw() {
 	if(level == -1) return;
 	for(auto &[i, j] : road_path) {
 		int x1 = i * LevelSetting::grid_size[level];
-		int y1 = j * LevelSetting::grid_size[level]+25;
+		int y1 = j * LevelSetting::grid_size[level] + LevelSetting::grid_top;
 		int x2 = x1 + LevelSetting::grid_size[level];
 		int y2 = y1 + LevelSetting::grid_size[level];
 		al_draw_filled_rectangle(x1, y1, x2, y2, al_map_rgb(255, 244, 173));
@@ -133,12 +148,23 @@ Level::is_onroad(const Rectangle &region) {
 Rectangle
 Level::grid_to_region(const Point &grid) const {
 	int x1 = grid.x * LevelSetting::grid_size[level];
-	int y1 = grid.y * LevelSetting::grid_size[level]+25;
+	int y1 = grid.y * LevelSetting::grid_size[level] + LevelSetting::grid_top;
 	int x2 = x1 + LevelSetting::grid_size[level];
 	int y2 = y1 + LevelSetting::grid_size[level];
 	return Rectangle{x1, y1, x2, y2};
 }
 
+/**
+ * @brief Get the lane (grid row) that contains the given y coordinate.
+ * @details Coordinates above or below the game field are clamped to the first or the last lane.
+ */
+int
+Level::lane_of(double y) const {
+	if(level == -1) return 0;
+	int lane = static_cast<int>(std::floor((y - LevelSetting::grid_top) / LevelSetting::grid_size[level]));
+	return std::clamp(lane, 0, lane_count() - 1);
+}
+
 vector<Point> Level::generate_right_to_left_path() const {
     vector<Point> path;
 	//int h[5] = {200,300,400,500,600};
@@ -4,6 +4,7 @@
 #include <vector>
 #include <utility>
 #include <tuple>
+#include <algorithm>
 #include "./shapes/Rectangle.h"
 
 /**
@@ -14,7 +15,7 @@
 class Level
 {
 public:
-	Level() {}
+	Level() : level(-1), grid_w(-1), grid_h(-1), monster_spawn_counter(-1) {}
 	void init();
 	void load_level(int lvl);
 	void update();
@@ -24,6 +25,11 @@ public:
 	std::vector<Point> generate_right_to_left_path() const;
 	//revise end
 	Rectangle grid_to_region(const Point &grid) const;
+	int lane_of(double y) const;
+	/**
+	 * @brief Number of lanes (grid rows) of the current level.
+	 */
+	int lane_count() const { return std::max(grid_h, 1); }
 	const std::vector<Point> &get_road_path() const
 	{ return road_path; }
 	int remain_monsters() const {
@@ -49,7 +55,7 @@ private:
 	 */
 	int grid_h;
 	/**
-	 * @brief Time remaining for the next monster to spawn.
+	 * @brief Time remaining (in ticks) for the next monster to spawn. Negative if the first spawn is not scheduled yet.
 	 */
 	int monster_spawn_counter;
 	/**
@@ -1,9 +1,54 @@
 #include "Game.h"
+#include "data/DataCenter.h"
+#include "Benchmark.h"
+#include "data/SpritePack.h"
+#include "data/MemoryCenter.h"
+#include "data/GIFCenter.h"
 #include <iostream>
+#include <cstring>
+#include <cstdlib>
 
+/**
+ * @details Command line options:
+ * @details * --headless: simulate a level without display, audio and timer, then exit.
+ * @details * --level <n>: level to be simulated in headless mode (default 1).
+ * @details * --max-ticks <n>: upper bound of simulated updates in headless mode.
+ * @details * --tick-rate <hz>: simulation ticks per second (default 60).
+ * @details * --draw-rate <hz>: frames drawn per second (default 60).
+ * @details * --scale <s>: size of the display relative to the window (default 1). Sprites are loaded at half or a quarter of their size when the display is that small, see LOD.
+ * @details * --gif-storage <rendered|lazy|indexed>: how the frames of GIFs are kept (default rendered), see GIFStorage.
+ * @details * --memory-budget <MB>: memory for loaded images, GIFs and sounds before the least recently used ones are evicted (default 256).
+ * @details * --bench-gif: measure the decoding throughput of every GIF under assets/gif, then exit.
+ * @details * --verify-gif: check that the frames composed in memory match the frames rendered pixel by pixel for every GIF under assets/gif, with each expand path (scalar and AVX2), then exit. The exit code is non-zero on a mismatch.
+ * @details * --bench-startup <cold|warm>: time every phase of the startup and every asset load until the level of --level is loaded, write a report under bench/, then exit. Must come after the other options.
+ * @details * --compile-assets: build the sprite pack from every file under assets, then exit.
+ */
 int main(int argc, char **argv) {
+	DataCenter *DC = DataCenter::get_instance();
+	int level = 1;
+	int max_ticks = 60 * 60 * 60;
+	for(int i = 1; i < argc; ++i) {
+		if(!strcmp(argv[i], "--headless")) DC->headless = true;
+		else if(!strcmp(argv[i], "--level") && i + 1 < argc) level = atoi(argv[++i]);
+		else if(!strcmp(argv[i], "--max-ticks") && i + 1 < argc) max_ticks = atoi(argv[++i]);
+		else if(!strcmp(argv[i], "--tick-rate") && i + 1 < argc) DC->FPS = atof(argv[++i]);
+		else if(!strcmp(argv[i], "--draw-rate") && i + 1 < argc) DC->draw_FPS = atof(argv[++i]);
+		else if(!strcmp(argv[i], "--scale") && i + 1 < argc) DC->display_scale = atof(argv[++i]);
+		else if(!strcmp(argv[i], "--gif-storage") && i + 1 < argc) {
+			const char *storage = argv[++i];
+			if(!strcmp(storage, "lazy")) GIFCenter::get_instance()->set_storage(GIFStorage::LAZY);
+			else if(!strcmp(storage, "indexed")) GIFCenter::get_instance()->set_storage(GIFStorage::INDEXED);
+			else GIFCenter::get_instance()->set_storage(GIFStorage::RENDERED);
+		}
+		else if(!strcmp(argv[i], "--memory-budget") && i + 1 < argc) MemoryCenter::get_instance()->budget = static_cast<size_t>(atof(argv[++i]) * (1 << 20));
+		else if(!strcmp(argv[i], "--bench-gif")) return bench_gif("./assets/gif");
+		else if(!strcmp(argv[i], "--verify-gif")) return verify_gif("./assets/gif");
+		else if(!strcmp(argv[i], "--bench-startup") && i + 1 < argc) return bench_startup(argv[++i], level);
+		else if(!strcmp(argv[i], "--compile-assets")) return SpritePack::compile(SpritePackSetting::path);
+	}
 	Game *game = new Game();
-	game->execute();
+	if(DC->headless) game->simulate(level, max_ticks);
+	else game->execute();
 	delete game;
 	return 0;
 }
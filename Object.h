@@ -12,8 +12,32 @@ public:
 public:
 	// pure function for drawing the object
 	virtual void draw() = 0;
+	/**
+	 * @brief Records the current center as the center of the previous simulation tick.
+	 * @details Moving objects call this at the beginning of their update, so that drawing can interpolate between the last two ticks.
+	 */
+	void save_prev_center() {
+		prev_x = shape->center_x();
+		prev_y = shape->center_y();
+		has_prev = true;
+	}
+	/**
+	 * @brief Center for drawing, interpolated between the previous and the current tick.
+	 * @param alpha progress from the previous tick (0) to the current tick (1).
+	 */
+	double draw_x(double alpha) const {
+		if(!has_prev) return shape->center_x();
+		return prev_x + (shape->center_x() - prev_x) * alpha;
+	}
+	double draw_y(double alpha) const {
+		if(!has_prev) return shape->center_y();
+		return prev_y + (shape->center_y() - prev_y) * alpha;
+	}
 public:
 	std::shared_ptr<Shape> shape;
+private:
+	bool has_prev = false;
+	double prev_x, prev_y;
 };
 
 #endif
@@ -1,24 +1,27 @@
 #include "Player.h"
+#include "data/DataCenter.h"
 
 // fixed settings
 namespace PlayerSetting {
 	constexpr int init_HP = 1;
 	constexpr int init_coin = 100;
-	constexpr int coin_freq = 180;
+	//! @brief Period of coin income, in seconds.
+	constexpr double coin_period = 3.0;
 	constexpr int coin_increase = 50;
 };
 
 Player::Player() : HP(PlayerSetting::init_HP), coin(PlayerSetting::init_coin) {
-	this->coin_freq = PlayerSetting::coin_freq;
+	this->coin_period = PlayerSetting::coin_period;
 	this->coin_increase = PlayerSetting::coin_increase;
-	coin_counter = PlayerSetting::coin_freq;
+	coin_counter = coin_period;
 }
 
 void
 Player::update() {
-	if(coin_counter) --coin_counter;
-	else {
+	DataCenter *DC = DataCenter::get_instance();
+	coin_counter -= 1.0 / DC->FPS;
+	if(coin_counter <= 0) {
 		coin += coin_increase;
-		coin_counter = coin_freq;
+		coin_counter += coin_period;
 	}
 }
@@ -9,9 +9,12 @@ public:
 	int HP;
 	int coin;
 private:
-	int coin_freq;
+	/**
+	 * @brief Period of coin income and time left to the next income, in seconds.
+	 */
+	double coin_period;
 	int coin_increase;
-	int coin_counter;
+	double coin_counter;
 };
 
 #endif
@@ -3,7 +3,11 @@
 #include "data/DataCenter.h"
 #include "data/ImageCenter.h"
 #include "data/FontCenter.h"
+#include "data/MemoryCenter.h"
+#include "data/LOD.h"
+#include "data/GIFCenter.h"
 #include <algorithm>
+#include <cmath>
 #include <allegro5/allegro_primitives.h>
 #include <allegro5/allegro_ttf.h>
 #include "shapes/Point.h"
@@ -15,10 +19,31 @@
 
 // fixed settings
 constexpr char love_img_path[] = "./assets/image/love.png";
+constexpr char coin_img_path[] = "./assets/image/2f2a3067b6b04ffd80f9ba182f572bc8.png";
 constexpr int love_img_padding = 5;
 constexpr int tower_img_left_padding = 30;
 constexpr int tower_img_top_padding = 30;
 
+/**
+ * @brief The heart, the coin and the tower cards are kept from init() on, so they are pinned for the lifetime of the UI.
+ */
+UI::UI() {
+	MemoryCenter *MC = MemoryCenter::get_instance();
+	MC->pin(AssetKind::IMAGE, love_img_path);
+	MC->pin(AssetKind::IMAGE, coin_img_path);
+	for(const std::string &path : TowerSetting::tower_menu_img_path)
+		MC->pin(AssetKind::IMAGE, path);
+}
+
+UI::~UI() {
+	if(shop_layer) al_destroy_bitmap(shop_layer);
+	MemoryCenter *MC = MemoryCenter::get_instance();
+	MC->unpin(AssetKind::IMAGE, love_img_path);
+	MC->unpin(AssetKind::IMAGE, coin_img_path);
+	for(const std::string &path : TowerSetting::tower_menu_img_path)
+		MC->unpin(AssetKind::IMAGE, path);
+}
+
 void
 UI::init() {
 	/*revise
@@ -49,14 +74,15 @@ UI::init() {
 DataCenter *DC = DataCenter::get_instance();
 	ImageCenter *IC = ImageCenter::get_instance();
 	love = IC->get(love_img_path);
+	coin = IC->get(coin_img_path);
 	int tl_x = tower_img_left_padding;
 	int tl_y = tower_img_top_padding;
 	int max_height = 0;
 	// arrange tower shop
 	for(size_t i = 0; i < (size_t)(TowerType::TOWERTYPE_MAX); ++i) {
 		ALLEGRO_BITMAP *bitmap = IC->get(TowerSetting::tower_menu_img_path[i]);
-		int w = al_get_bitmap_width(bitmap);
-		int h = al_get_bitmap_height(bitmap);
+		int w = LOD::width(bitmap);
+		int h = LOD::height(bitmap);
 		tl_y += max_height + tower_img_top_padding;
 		max_height = 0;
 		tower_items.emplace_back(bitmap, Point{tl_x, tl_y}, TowerSetting::tower_price[i]);
@@ -65,6 +91,8 @@ DataCenter *DC = DataCenter::get_instance();
 	debug_log("<UI> state: change to HALT\n");
 	state = STATE::HALT;
 	on_item = -1;
+	if(shop_layer) al_destroy_bitmap(shop_layer);
+	shop_layer = nullptr;
 }
 
 void
@@ -75,17 +103,15 @@ UI::update() {
 	switch(state) {
 		case STATE::HALT: {
 			//sun
-			for (Sun *sun : DC->suns) {
+			for (size_t i = 0; i < DC->suns.size(); ++i) {
+                Sun *sun = DC->suns[i];
                 if (sun->get_region().overlap(Rectangle{mouse.x, mouse.y, mouse.x + 1, mouse.y + 1})) {
                     if (DC->mouse_state[1] && !DC->prev_mouse_state[1]) {
                         // 當鼠標點擊時，拾取sun
                         debug_log("<UI> Sun picked up!\n");
                         DC->player->coin += 50;  
                         // 移除sun
-                        auto it = std::find(DC->suns.begin(), DC->suns.end(), sun);
-                        if (it != DC->suns.end()) {
-                            DC->suns.erase(it);
-                        }
+                        DC->suns.remove_at(i);
                         break;
                     }
                 }
@@ -93,8 +119,8 @@ UI::update() {
 			//tower
 			for(size_t i = 0; i < tower_items.size(); ++i) {
 				auto &[bitmap, p, price] = tower_items[i];
-				int w = al_get_bitmap_width(bitmap);
-				int h = al_get_bitmap_height(bitmap);
+				int w = LOD::width(bitmap);
+				int h = LOD::height(bitmap);
 				// hover on a shop tower item
 				if(mouse.overlap(Rectangle{p.x, p.y, p.x+w, p.y+h})) {
 					on_item = i;
@@ -106,8 +132,8 @@ UI::update() {
 			break;
 		} case STATE::HOVER: {
 			auto &[bitmap, p, price] = tower_items[on_item];
-			int w = al_get_bitmap_width(bitmap);
-			int h = al_get_bitmap_height(bitmap);
+			int w = LOD::width(bitmap);
+			int h = LOD::height(bitmap);
 			if(!mouse.overlap(Rectangle{p.x, p.y, p.x+w, p.y+h})) {
 				on_item = -1;
 				debug_log("<UI> state: change to HALT\n");
@@ -145,9 +171,8 @@ UI::update() {
 			int w = al_get_bitmap_width(bitmap);
 			int h = al_get_bitmap_height(bitmap);
 			*/
-			ALGIF_ANIMATION *animation = Tower::get_animation(static_cast<TowerType>(on_item));
-			int w = animation->width;
-			int h = animation->height;
+			// The size comes from the GIF header, since the animation may not be loaded yet.
+			auto [w, h] = GIFCenter::get_instance()->get_size(TowerSetting::tower_gif_path[on_item]);
 			//revise end
 			Rectangle place_region{mouse.x - w / 2, mouse.y - h / 2, DC->mouse.x + w / 2, DC->mouse.y + h / 2};
 			bool place = true;
@@ -160,10 +185,8 @@ UI::update() {
 			if(!place) {
 				debug_log("<UI> Tower place failed.\n");
 			} else {
-				Tower *new_tower = Tower::create_tower(static_cast<TowerType>(on_item), mouse);
-    			new_tower->planted = true;  // 设置 planted 为 true
-				debug_log("<UI> Tower planted status: %d\n", new_tower->planted);  // 调试信息
-				DC->towers.emplace_back(new_tower);
+				Tower::plant_tower(static_cast<TowerType>(on_item), mouse);
+				debug_log("<UI> Tower planted.\n");
 				DC->player->coin -= std::get<2>(tower_items[on_item]);
 			}
 			debug_log("<UI> state: change to HALT\n");
@@ -173,31 +196,26 @@ UI::update() {
 	}
 }
 
+/**
+ * @brief Draw the coin counter and the tower shop, with the mask on the hovered item.
+ * @param hover index of the hovered item, or -1.
+ */
 void
-UI::draw() {
-	ALLEGRO_BITMAP *image = al_load_bitmap("assets/image/2f2a3067b6b04ffd80f9ba182f572bc8.png");
+UI::draw_shop(int coin, int hover) {
 	DataCenter *DC = DataCenter::get_instance();
 	FontCenter *FC = FontCenter::get_instance();
-	const Point &mouse = DC->mouse;
-	// draw HP
 	const int &game_field_length = DC->game_field_length;
-	const int &player_HP = DC->player->HP;
-	int love_width = al_get_bitmap_width(love);
-	/*for(int i = 1; i <= player_HP; ++i) {
-		al_draw_bitmap(love, game_field_length - (love_width + love_img_padding) * i, love_img_padding, 0);
-	}*/
 	// draw coin
-	const int &player_coin = DC->player->coin;
-	al_draw_bitmap(image, game_field_length+love_img_padding , love_img_padding,0);
+	LOD::draw(this->coin, game_field_length + love_img_padding, love_img_padding, 0);
 	al_draw_textf(
 		FC->courier_new[FontSize::MEDIUM], al_map_rgb(0, 0, 0),
 		game_field_length+love_img_padding+20, love_img_padding +7,
-		ALLEGRO_ALIGN_LEFT, " %5d", player_coin);
+		ALLEGRO_ALIGN_LEFT, " %5d", coin);
 	// draw tower shop items
 	for(auto &[bitmap, p, price] : tower_items) {
-		int w = al_get_bitmap_width(bitmap);
-		int h = al_get_bitmap_height(bitmap);
-		al_draw_bitmap(bitmap, p.x, p.y, 0);
+		int w = LOD::width(bitmap);
+		int h = LOD::height(bitmap);
+		LOD::draw(bitmap, p.x, p.y, 0);
 		al_draw_rectangle(
 			p.x - 1, p.y - 1,
 			p.x + w + 1, p.y + h + 1,
@@ -207,6 +225,82 @@ UI::draw() {
 			p.x + w / 2, p.y + h,
 			ALLEGRO_ALIGN_CENTRE, "%d", price);
 	}
+	if(hover >= 0) {
+		auto &[bitmap, p, price] = tower_items[hover];
+		int w = LOD::width(bitmap);
+		int h = LOD::height(bitmap);
+		// Create a semitransparent mask covered on the hovered tower.
+		al_draw_filled_rectangle(p.x, p.y, p.x + w, p.y + h, al_map_rgba(50, 50, 50, 64));
+	}
+}
+
+/**
+ * @brief Render the shop into its retained layer, creating the layer on the first call.
+ * @details The layer has one pixel per display pixel, so blitting it gives the same image as drawing the shop directly. It covers the coin counter, whose text is given room for 7 digits, and the tower cards with their borders and prices.
+ * @details Rendering writes to a bitmap, so drawing is released during it if it is held. If the layer cannot be created, shop_layer stays nullptr.
+ */
+void
+UI::render_shop(int coin, int hover) {
+	DataCenter *DC = DataCenter::get_instance();
+	double scale = DC->display_scale;
+	if(!shop_layer) {
+		ALLEGRO_FONT *font = FontCenter::get_instance()->courier_new[FontSize::MEDIUM];
+		int coin_x = DC->game_field_length + love_img_padding;
+		shop_region = Rectangle{
+			coin_x, love_img_padding,
+			coin_x + std::max(LOD::width(this->coin), 20 + al_get_text_width(font, " 0000000")),
+			love_img_padding + std::max(LOD::height(this->coin), 7 + al_get_font_line_height(font))};
+		for(auto &[bitmap, p, price] : tower_items) {
+			int w = LOD::width(bitmap);
+			int h = LOD::height(bitmap);
+			shop_region.x1 = std::min<double>(shop_region.x1, p.x - 1);
+			shop_region.y1 = std::min<double>(shop_region.y1, p.y - 1);
+			shop_region.x2 = std::max<double>(shop_region.x2, std::max(p.x + w + 2, p.x + (w + al_get_text_width(font, "00000")) / 2));
+			shop_region.y2 = std::max<double>(shop_region.y2, p.y + h + al_get_font_line_height(font));
+		}
+		int w = std::ceil((shop_region.x2 - shop_region.x1) * scale);
+		int h = std::ceil((shop_region.y2 - shop_region.y1) * scale);
+		shop_layer = al_create_bitmap(w, h);
+		if(!shop_layer) {
+			debug_log("<UI> cannot create the shop layer of %dx%d.\n", w, h);
+			return;
+		}
+	}
+	bool held = al_is_bitmap_drawing_held();
+	if(held) al_hold_bitmap_drawing(false);
+	ALLEGRO_STATE state;
+	al_store_state(&state, ALLEGRO_STATE_TARGET_BITMAP | ALLEGRO_STATE_TRANSFORM);
+	al_set_target_bitmap(shop_layer);
+	al_clear_to_color(al_map_rgba(0, 0, 0, 0));
+	ALLEGRO_TRANSFORM transform;
+	al_identity_transform(&transform);
+	al_translate_transform(&transform, -shop_region.x1, -shop_region.y1);
+	al_scale_transform(&transform, scale, scale);
+	al_use_transform(&transform);
+	draw_shop(coin, hover);
+	al_restore_state(&state);
+	if(held) al_hold_bitmap_drawing(true);
+	layer_coin = coin;
+	layer_hover = hover;
+}
+
+/**
+ * @details The coin counter and the tower shop are retained in a layer that is rendered again only when the coin or the hovered item changes, so they cost one blit per frame otherwise.
+ */
+void
+UI::draw() {
+	DataCenter *DC = DataCenter::get_instance();
+	const Point &mouse = DC->mouse;
+	const int &player_coin = DC->player->coin;
+	int hover = state == STATE::HOVER ? on_item : -1;
+	if(!shop_layer || layer_coin != player_coin || layer_hover != hover)
+		render_shop(player_coin, hover);
+	if(shop_layer) {
+		al_draw_scaled_bitmap(
+			shop_layer, 0, 0, al_get_bitmap_width(shop_layer), al_get_bitmap_height(shop_layer),
+			shop_region.x1, shop_region.y1,
+			al_get_bitmap_width(shop_layer) / DC->display_scale, al_get_bitmap_height(shop_layer) / DC->display_scale, 0);
+	} else draw_shop(player_coin, hover);
 
 	switch(state) {
 		static Tower *selected_tower = nullptr;
@@ -218,11 +312,7 @@ UI::draw() {
 			}
 			break;
 		} case STATE::HOVER: {
-			auto &[bitmap, p, price] = tower_items[on_item];
-			int w = al_get_bitmap_width(bitmap);
-			int h = al_get_bitmap_height(bitmap);
-			// Create a semitransparent mask covered on the hovered tower.
-			al_draw_filled_rectangle(p.x, p.y, p.x + w, p.y + h, al_map_rgba(50, 50, 50, 64));
+			// The mask on the hovered tower is part of the shop layer.
 			break;
 		}
 		case STATE::SELECT: {
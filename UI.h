@@ -5,15 +5,19 @@
 #include <vector>
 #include <tuple>
 #include "./shapes/Point.h"
+#include "./shapes/Rectangle.h"
 
 class UI
 {
 public:
-	UI() {}
+	UI();
+	~UI();
 	void init();
 	void update();
 	void draw();
 private:
+	void draw_shop(int coin, int hover);
+	void render_shop(int coin, int hover);
 	enum class STATE {
 		HALT, // -> HOVER
 		HOVER, // -> HALT, SELECT
@@ -22,9 +26,18 @@ private:
 	};
 	STATE state;
 	ALLEGRO_BITMAP *love;
+	ALLEGRO_BITMAP *coin;
 	// tower menu bitmap, (top-left x, top-left y), price
 	std::vector<std::tuple<ALLEGRO_BITMAP*, Point, int>> tower_items;
 	int on_item;
+	/**
+	 * @brief Retained layer of the coin counter and the tower shop, the region it covers in window coordinates, and the coin and hovered item it was rendered for.
+	 * @details Created on the first draw, since headless mode never draws.
+	 */
+	ALLEGRO_BITMAP *shop_layer = nullptr;
+	Rectangle shop_region;
+	int layer_coin = -1;
+	int layer_hover = -1;
 };
 
 #endif
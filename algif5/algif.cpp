@@ -2,6 +2,12 @@
 #include <allegro5/allegro_primitives.h>
 #include <math.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define ALGIF_HAVE_AVX2_PATH
+#endif
 
 /* Renders the next frame in a GIF animation to the given position.
  * You need to call this in order on the same destination for frames
@@ -57,29 +63,391 @@ void algif_render_frame(ALGIF_ANIMATION *gif, int frame, int xpos, int ypos) {
     }
 }
 
-ALGIF_ANIMATION *algif_load_animation_f(ALLEGRO_FILE *file) {
+/* Expands one row of palette indices into 32-bit pixels. Transparent pixels
+ * keep the destination value.
+ */
+static void expand_row(uint32_t *dst, uint8_t const *src, int n,
+        uint32_t const *lut, int transparent_index) {
+    int x;
+    for (x = 0; x < n; x++) {
+        int c = src[x];
+        if (c != transparent_index)
+            dst[x] = lut[c];
+    }
+}
+
+#ifdef ALGIF_HAVE_AVX2_PATH
+/* Same as expand_row, 8 pixels at a time with a gather from the lookup table.
+ */
+__attribute__((target("avx2")))
+static void expand_row_avx2(uint32_t *dst, uint8_t const *src, int n,
+        uint32_t const *lut, int transparent_index) {
+    __m256i transparent = _mm256_set1_epi32(transparent_index);
+    int x;
+    for (x = 0; x + 8 <= n; x += 8) {
+        __m256i index = _mm256_cvtepu8_epi32(_mm_loadl_epi64((__m128i const *)(src + x)));
+        __m256i color = _mm256_i32gather_epi32((int const *)lut, index, 4);
+        __m256i keep = _mm256_cmpeq_epi32(index, transparent);
+        __m256i old = _mm256_loadu_si256((__m256i const *)(dst + x));
+        _mm256_storeu_si256((__m256i *)(dst + x), _mm256_blendv_epi8(color, old, keep));
+    }
+    expand_row(dst + x, src + x, n - x, lut, transparent_index);
+}
+#endif
+
+typedef void (*expand_row_func)(uint32_t *, uint8_t const *, int, uint32_t const *, int);
+
+static expand_row_func select_expand_row(void) {
+#ifdef ALGIF_HAVE_AVX2_PATH
+    if (__builtin_cpu_supports("avx2"))
+        return expand_row_avx2;
+#endif
+    return expand_row;
+}
+
+static expand_row_func forced_expand_row = NULL;
+
+/* Forces the implementation used by algif_compose_frame, e.g. to check each
+ * of them against algif_render_frame. Must not be called while frames are
+ * composed on another thread. Returns false, and changes nothing, if the path
+ * is not available on this CPU or in this build.
+ */
+bool algif_set_expand_path(ALGIF_EXPAND_PATH path) {
+    switch (path) {
+        case ALGIF_EXPAND_AUTO:
+            forced_expand_row = NULL;
+            return true;
+        case ALGIF_EXPAND_SCALAR:
+            forced_expand_row = expand_row;
+            return true;
+        case ALGIF_EXPAND_AVX2:
+#ifdef ALGIF_HAVE_AVX2_PATH
+            if (__builtin_cpu_supports("avx2")) {
+                forced_expand_row = expand_row_avx2;
+                return true;
+            }
+#endif
+            return false;
+    }
+    return false;
+}
+
+/* Clips the rectangle of a frame to the animation. Returns false if nothing is
+ * left.
+ */
+static bool clip_frame(ALGIF_ANIMATION const *gif, ALGIF_FRAME const *f,
+        int *x1, int *y1, int *x2, int *y2) {
+    *x1 = f->xoff < 0 ? 0 : f->xoff;
+    *y1 = f->yoff < 0 ? 0 : f->yoff;
+    *x2 = f->xoff + f->bitmap_8_bit->w;
+    *y2 = f->yoff + f->bitmap_8_bit->h;
+    if (*x2 > gif->width) *x2 = gif->width;
+    if (*y2 > gif->height) *y2 = gif->height;
+    return *x1 < *x2 && *y1 < *y2;
+}
+
+/* Renders a frame into canvas, a gif->width * gif->height array of pixels in
+ * ALLEGRO_PIXEL_FORMAT_ABGR_8888. The result is the same as algif_render_frame
+ * on a new bitmap. store must have the same size as canvas and be passed
+ * unchanged to every frame in order [0..gif->frames_count - 1], since the
+ * disposal method 3 saves the area of a frame there for the next one. Only
+ * the area of that frame is saved.
+ */
+void algif_compose_frame(ALGIF_ANIMATION const *gif, int frame, uint32_t *canvas,
+        uint32_t *store) {
+    /* Initialized once, even if frames are composed on several threads. */
+    static expand_row_func const selected = select_expand_row();
+    expand_row_func const expand = forced_expand_row ? forced_expand_row : selected;
+    ALGIF_FRAME const *f = &gif->frames[frame];
+    ALGIF_PALETTE const *pal;
+    uint32_t lut[256];
+    int x1, y1, x2, y2, y, c;
+    int w = gif->width;
+
+    memset(canvas, 0, sizeof(uint32_t) * w * gif->height);
+    if (frame > 0) {
+        ALGIF_FRAME const *p = &gif->frames[frame - 1];
+        /* Disposal 2 clears to transparent, which the canvas already is. */
+        if (p->disposal_method == 3 && clip_frame(gif, p, &x1, &y1, &x2, &y2)) {
+            for (y = y1; y < y2; y++)
+                memcpy(canvas + y * w + x1, store + y * w + x1, sizeof(uint32_t) * (x2 - x1));
+        }
+    }
+    if (!clip_frame(gif, f, &x1, &y1, &x2, &y2))
+        return;
+    if (f->disposal_method == 3) {
+        for (y = y1; y < y2; y++)
+            memcpy(store + y * w + x1, canvas + y * w + x1, sizeof(uint32_t) * (x2 - x1));
+    }
+
+    pal = &f->palette;
+    if (pal->colors_count == 0)
+        pal = &gif->palette;
+    for (c = 0; c < 256; c++) {
+        ALGIF_RGB const *rgb = &pal->colors[c];
+        lut[c] = (uint32_t)rgb->r | (uint32_t)rgb->g << 8 | (uint32_t)rgb->b << 16 | 0xff000000u;
+    }
+    for (y = y1; y < y2; y++) {
+        uint8_t const *src = f->bitmap_8_bit->data + (y - f->yoff) * f->bitmap_8_bit->w + (x1 - f->xoff);
+        expand(canvas + y * w + x1, src, x2 - x1, lut, f->transparent_index);
+    }
+}
+
+/* Copies a composed canvas into a bitmap with a single lock. Returns false if
+ * the bitmap cannot be locked.
+ */
+static bool upload_canvas(ALLEGRO_BITMAP *bitmap, uint32_t const *canvas, int w, int h) {
+    ALLEGRO_LOCKED_REGION *lr = al_lock_bitmap(bitmap, ALLEGRO_PIXEL_FORMAT_ABGR_8888,
+        ALLEGRO_LOCK_WRITEONLY);
+    int y;
+    if (!lr)
+        return false;
+    for (y = 0; y < h; y++)
+        memcpy((uint8_t *)lr->data + y * lr->pitch, canvas + y * w, sizeof(uint32_t) * w);
+    al_unlock_bitmap(bitmap);
+    return true;
+}
+
+/* Returns a size of an animation at the given level of detail, rounded up so
+ * that no pixel is lost.
+ */
+int algif_lod_size(int size, int lod) {
+    return (size + (1 << lod) - 1) >> lod;
+}
+
+/* Returns the size of the frame bitmaps of an animation, which is the size of
+ * the animation at its level of detail.
+ */
+int algif_frame_width(ALGIF_ANIMATION const *gif) {
+    return algif_lod_size(gif->width, gif->lod);
+}
+
+int algif_frame_height(ALGIF_ANIMATION const *gif) {
+    return algif_lod_size(gif->height, gif->lod);
+}
+
+/* Downscales count canvases of w * h ABGR pixels, stored one after another,
+ * by 2^lod in each dimension with a box filter. Works in place: the results
+ * are stored one after another from the start of pixels, each of
+ * algif_lod_size(w, lod) * algif_lod_size(h, lod) pixels. The four channels
+ * are averaged alike, which is right for premultiplied pixels such as
+ * composed frames, whose transparent pixels are 0. Boxes over the right and
+ * bottom edges are completed with transparent pixels.
+ */
+void algif_downscale(uint32_t *pixels, int w, int h, int count, int lod) {
+    int f = 1 << lod;
+    int lw = algif_lod_size(w, lod);
+    int lh = algif_lod_size(h, lod);
+    int i, x, y, bx, by, c;
+    if (lod <= 0)
+        return;
+    /* Every pixel is written at or before the first pixel its box reads, so
+     * no pixel is overwritten before it is read.
+     */
+    for (i = 0; i < count; i++) {
+        uint32_t const *src = pixels + (size_t)i * w * h;
+        uint32_t *dst = pixels + (size_t)i * lw * lh;
+        for (y = 0; y < lh; y++) {
+            for (x = 0; x < lw; x++) {
+                uint32_t sum[4] = {0, 0, 0, 0};
+                uint32_t out = 0;
+                for (by = y * f; by < y * f + f && by < h; by++) {
+                    for (bx = x * f; bx < x * f + f && bx < w; bx++) {
+                        uint32_t p = src[(size_t)by * w + bx];
+                        for (c = 0; c < 4; c++)
+                            sum[c] += p >> (8 * c) & 0xff;
+                    }
+                }
+                for (c = 0; c < 4; c++)
+                    out |= ((sum[c] + (f * f >> 1)) >> (2 * lod)) << (8 * c);
+                dst[(size_t)y * lw + x] = out;
+            }
+        }
+    }
+}
+
+/* Sums the frame durations into gif->duration and the gif->frame_end table.
+ */
+void algif_compute_timeline(ALGIF_ANIMATION *gif) {
+    int i;
+    gif->duration = 0;
+    free(gif->frame_end);
+    gif->frame_end = (int*)malloc(sizeof(int) * (gif->frames_count > 0 ? gif->frames_count : 1));
+    for (i = 0; i < gif->frames_count; i++) {
+        gif->duration += gif->frames[i].duration;
+        gif->frame_end[i] = gif->duration;
+    }
+}
+
+/* Computes the timeline of a parsed GIF and composes every frame, without
+ * touching any display, so it may run on any thread. *pixels receives
+ * frames_count canvases of width * height ABGR pixels one after another, or
+ * NULL if they cannot be allocated. Pass both to algif_upload_animation.
+ */
+bool algif_compose_animation(ALGIF_ANIMATION *gif, uint32_t **pixels) {
+    int i;
+    size_t canvas_size = (size_t)gif->width * gif->height;
+    uint32_t *store = (uint32_t *)malloc(sizeof(uint32_t) * (canvas_size ? canvas_size : 1));
+    uint32_t *canvas = (uint32_t *)malloc(sizeof(uint32_t) * (canvas_size * gif->frames_count + 1));
+
+    algif_compute_timeline(gif);
+    *pixels = NULL;
+    if (store && canvas) {
+        for (i = 0; i < gif->frames_count; i++)
+            algif_compose_frame(gif, i, canvas + i * canvas_size, store);
+        *pixels = canvas;
+        canvas = NULL;
+    }
+    free(canvas);
+    free(store);
+    return *pixels != NULL;
+}
+
+/* Decodes a GIF file and composes every frame. See algif_compose_animation.
+ */
+ALGIF_ANIMATION *algif_decode_animation_f(ALLEGRO_FILE *file, uint32_t **pixels) {
     ALGIF_ANIMATION *gif = algif_load_raw(file);
 
-    if (!gif)
-        return gif;
+    *pixels = NULL;
+    if (gif)
+        algif_compose_animation(gif, pixels);
+    return gif;
+}
+
+ALGIF_ANIMATION *algif_decode_animation(char const *filename, uint32_t **pixels) {
+    ALLEGRO_FILE *file = al_fopen(filename, "rb");
+    return algif_decode_animation_f(file, pixels);
+}
+
+static ALGIF_FRAME_ALLOCATOR frame_allocator = NULL;
+static void *frame_allocator_user = NULL;
+
+/* Sets the function that creates the bitmaps of rendered frames, e.g. to
+ * place them in a texture atlas. The allocator may return NULL to fall back
+ * to a standalone bitmap. Pass NULL to always create standalone bitmaps.
+ */
+void algif_set_frame_allocator(ALGIF_FRAME_ALLOCATOR allocator, void *user) {
+    frame_allocator = allocator;
+    frame_allocator_user = user;
+}
+
+static ALGIF_FRAME_EXPANDER frame_expander = NULL;
+static void *frame_expander_user = NULL;
+
+/* Sets the function that provides the bitmap of a frame that has no rendered
+ * bitmap, e.g. from a pool of recently expanded frames. The frame getters
+ * return NULL for such frames if no expander is set. The expander may keep
+ * the bitmap in the frame, so it gets the animation as a mutable pointer.
+ */
+void algif_set_frame_expander(ALGIF_FRAME_EXPANDER expander, void *user) {
+    frame_expander = expander;
+    frame_expander_user = user;
+}
+
+static ALLEGRO_BITMAP *frame_bitmap(ALGIF_ANIMATION *gif, int frame) {
+    ALLEGRO_BITMAP *rendered = gif->frames[frame].rendered;
+    if (!rendered && frame_expander)
+        rendered = frame_expander(gif, frame, frame_expander_user);
+    return rendered;
+}
+
+/* Composes one frame from the 8-bit frame data and copies it into bitmap,
+ * which must have the size of algif_frame_width and algif_frame_height. The
+ * frame is downscaled to the level of detail of the animation. Composing starts at the first
+ * frame of the run of disposal 3 frames before it, since only those leave
+ * something for the next frame. Must run on the thread that owns the display.
+ * Returns false if the bitmap cannot be locked.
+ */
+bool algif_expand_frame(ALGIF_ANIMATION const *gif, int frame, ALLEGRO_BITMAP *bitmap) {
+    size_t canvas_size = (size_t)gif->width * gif->height;
+    uint32_t *canvas = (uint32_t *)malloc(sizeof(uint32_t) * (canvas_size ? canvas_size : 1));
+    uint32_t *store = (uint32_t *)calloc(canvas_size ? canvas_size : 1, sizeof(uint32_t));
+    int start = frame;
+    bool ok = false;
+    while (start > 0 && gif->frames[start - 1].disposal_method == 3)
+        start--;
+    if (canvas && store) {
+        for (; start <= frame; start++)
+            algif_compose_frame(gif, start, canvas, store);
+        algif_downscale(canvas, gif->width, gif->height, 1, gif->lod);
+        ok = upload_canvas(bitmap, canvas, algif_frame_width(gif), algif_frame_height(gif));
+    }
+    free(canvas);
+    free(store);
+    return ok;
+}
+
+static ALLEGRO_BITMAP *create_frame_bitmap(int w, int h) {
+    ALLEGRO_BITMAP *bitmap = NULL;
+    if (frame_allocator)
+        bitmap = frame_allocator(w, h, frame_allocator_user);
+    if (!bitmap)
+        bitmap = al_create_bitmap(w, h);
+    return bitmap;
+}
 
+/* Creates the frame bitmaps of an animation from algif_decode_animation. Must
+ * run on the thread that owns the display. pixels is freed. If the animation
+ * has a level of detail, pixels must have been downscaled to it with
+ * algif_downscale.
+ */
+void algif_upload_animation(ALGIF_ANIMATION *gif, uint32_t *pixels) {
+    algif_upload_frames(gif, pixels, NULL);
+}
+
+/* Same as algif_upload_animation, but lets frames share bitmaps. Frames that
+ * already have a rendered bitmap are kept as they are. If source is not NULL,
+ * a frame i with source[i] < i takes the bitmap of frame source[i] instead of
+ * getting its own. Shared bitmaps must be destroyed by the caller, and the
+ * rendered pointers cleared, before algif_destroy_animation.
+ */
+void algif_upload_frames(ALGIF_ANIMATION *gif, uint32_t *pixels, int const *source) {
     al_init_primitives_addon();
 
-    gif->duration = 0;
     ALLEGRO_STATE s;
     al_store_state(&s, ALLEGRO_STATE_TARGET_BITMAP | ALLEGRO_STATE_BLENDER);
     al_set_blender(ALLEGRO_ADD, ALLEGRO_ONE, ALLEGRO_ZERO);
     int n = gif->frames_count;
     int i;
+    int w = algif_frame_width(gif), h = algif_frame_height(gif);
+    size_t canvas_size = (size_t)w * h;
+    ALLEGRO_TRANSFORM t;
+    /* The pixel by pixel path draws at the size of the animation. */
+    al_identity_transform(&t);
+    al_scale_transform(&t, 1.0f / (1 << gif->lod), 1.0f / (1 << gif->lod));
+    /* Once a frame cannot be locked, the remaining frames are drawn pixel by
+     * pixel, since the two paths keep the disposal 3 area in different places.
+     */
+    bool fast = pixels != NULL;
     for (i = 0; i < n; i++) {
         ALGIF_FRAME *f = &gif->frames[i];
-        f->rendered = al_create_bitmap(gif->width, gif->height);
+        if (f->rendered)
+            continue;
+        if (source && source[i] < i) {
+            f->rendered = gif->frames[source[i]].rendered;
+            continue;
+        }
+        f->rendered = create_frame_bitmap(w, h);
+        if (fast) {
+            fast = upload_canvas(f->rendered, pixels + i * canvas_size, w, h);
+            if (fast)
+                continue;
+        }
         al_set_target_bitmap(f->rendered);
+        al_use_transform(&t);
         algif_render_frame(gif, i, 0, 0);
-        gif->duration += f->duration;
     }
+    free(pixels);
 
     al_restore_state(&s);
+}
+
+ALGIF_ANIMATION *algif_load_animation_f(ALLEGRO_FILE *file) {
+    uint32_t *pixels;
+    ALGIF_ANIMATION *gif = algif_decode_animation_f(file, &pixels);
+
+    if (gif)
+        algif_upload_animation(gif, pixels);
     return gif;
 }
 
@@ -87,6 +455,33 @@ ALGIF_ANIMATION *algif_load_animation(char const *filename) {
     ALLEGRO_FILE *file = al_fopen(filename, "rb");
     return algif_load_animation_f(file);
 }
+
+/* Releases the 8-bit data of every frame, once the frames are rendered or
+ * when they never will be.
+ */
+void algif_release_frame_data(ALGIF_ANIMATION *gif) {
+    int i;
+    for (i = 0; i < gif->frames_count; i++) {
+        ALGIF_FRAME *f = &gif->frames[i];
+        algif_destroy_bitmap(f->bitmap_8_bit);
+        f->bitmap_8_bit = NULL;
+    }
+}
+
+/* Loads only the metadata of a GIF animation: size, frame count, frame
+ * durations and loop count. No frame is rendered and the 8-bit frame data is
+ * released right after decoding, so this works without any display.
+ */
+ALGIF_ANIMATION *algif_load_info(char const *filename) {
+    ALGIF_ANIMATION *gif = algif_load_raw(al_fopen(filename, "rb"));
+
+    if (!gif)
+        return gif;
+
+    algif_compute_timeline(gif);
+    algif_release_frame_data(gif);
+    return gif;
+}
 bool algif_draw_gif(ALGIF_ANIMATION *gif, double x, double y, int flip) {
     ALLEGRO_BITMAP *frame = algif_get_bitmap(gif, al_get_time());
     if (frame) {
@@ -108,7 +503,7 @@ ALLEGRO_BITMAP *algif_get_bitmap(ALGIF_ANIMATION *gif, double seconds) {
         gif->done = false;
         gif->start_time = 0;
         gif->display_index = 0;
-        return gif->frames[0].rendered;
+        return frame_bitmap(gif, 0);
     }
     // loop n times
     if(gif->loop > 0 && seconds > one_gif_time * gif->loop){
@@ -118,24 +513,75 @@ ALLEGRO_BITMAP *algif_get_bitmap(ALGIF_ANIMATION *gif, double seconds) {
         return NULL;
     }
     seconds = fmod(seconds, one_gif_time);
-    int n = gif->frames_count;
-    double progress_gif_time = 0;
-    int i;
-    for (i = 0; i < n; i++) {
-        progress_gif_time += gif->frames[i].duration / 100.0;
-        if (seconds < progress_gif_time){
-            gif->display_index = i;
-            return gif->frames[i].rendered;
-        }
-
-    }
-    return gif->frames[0].rendered;
+    gif->display_index = algif_frame_at(gif, seconds);
+    return frame_bitmap(gif, gif->display_index);
 }
 
 ALLEGRO_BITMAP *algif_get_frame_bitmap(ALGIF_ANIMATION *gif, int i) {
-    return gif->frames[i].rendered;
+    return frame_bitmap(gif, i);
 }
 
 double algif_get_frame_duration(ALGIF_ANIMATION *gif, int i) {
     return gif->frames[i].duration / 100.0;
-}
\ No newline at end of file
+}
+
+/* Returns the index of the frame shown at the given time since the start of
+ * the animation, by binary search on the frame_end table. Times past the end
+ * of the animation give the last frame.
+ */
+int algif_frame_at(ALGIF_ANIMATION const *gif, double seconds) {
+    double t = seconds * 100;
+    int lo = 0, hi = gif->frames_count - 1;
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        if (gif->frame_end[mid] > t)
+            hi = mid;
+        else
+            lo = mid + 1;
+    }
+    return lo;
+}
+
+void algif_cursor_reset(ALGIF_CURSOR *cursor) {
+    cursor->frame = 0;
+    cursor->time = 0;
+    cursor->loops = 0;
+    cursor->done = false;
+}
+
+/* Moves the cursor forward by the given number of seconds. A step shorter
+ * than a frame only compares against the end of the current frame, so the
+ * usual per-tick advance is O(1). Wrapping around uses algif_frame_at.
+ */
+void algif_cursor_advance(ALGIF_CURSOR *cursor, ALGIF_ANIMATION const *gif, double seconds) {
+    double one_gif_time = gif->duration / 100.0;
+    if (cursor->done || one_gif_time <= 0)
+        return;
+    cursor->time += seconds;
+    if (cursor->time >= one_gif_time) {
+        int wraps = (int)(cursor->time / one_gif_time);
+        cursor->loops += wraps;
+        cursor->time -= wraps * one_gif_time;
+        if (gif->loop > 0 && cursor->loops >= gif->loop) {
+            cursor->done = true;
+            cursor->frame = 0;
+            cursor->time = 0;
+            return;
+        }
+        cursor->frame = algif_frame_at(gif, cursor->time);
+        return;
+    }
+    while (cursor->frame + 1 < gif->frames_count &&
+            cursor->time * 100 >= gif->frame_end[cursor->frame])
+        cursor->frame++;
+}
+
+/* Returns the rendered frame at the cursor, or NULL if the animation has
+ * finished its loops. The animation is not const since the frame expander
+ * may render the frame into it.
+ */
+ALLEGRO_BITMAP *algif_cursor_bitmap(ALGIF_CURSOR const *cursor, ALGIF_ANIMATION *gif) {
+    if (cursor->done)
+        return NULL;
+    return frame_bitmap(gif, cursor->frame);
+}
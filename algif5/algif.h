@@ -8,6 +8,16 @@ typedef struct ALGIF_FRAME ALGIF_FRAME;
 typedef struct ALGIF_PALETTE ALGIF_PALETTE;
 typedef struct ALGIF_BITMAP ALGIF_BITMAP;
 typedef struct ALGIF_RGB ALGIF_RGB;
+typedef struct ALGIF_CURSOR ALGIF_CURSOR;
+typedef ALLEGRO_BITMAP *(*ALGIF_FRAME_ALLOCATOR)(int w, int h, void *user);
+typedef ALLEGRO_BITMAP *(*ALGIF_FRAME_EXPANDER)(ALGIF_ANIMATION *gif, int frame, void *user);
+
+/* Implementation used to expand palette indices into pixels when composing. */
+typedef enum ALGIF_EXPAND_PATH {
+    ALGIF_EXPAND_AUTO, /* the fastest one the CPU supports */
+    ALGIF_EXPAND_SCALAR,
+    ALGIF_EXPAND_AVX2
+} ALGIF_EXPAND_PATH;
 
 struct ALGIF_RGB {
     uint8_t r, g, b;
@@ -21,6 +31,7 @@ struct ALGIF_PALETTE {
 struct ALGIF_BITMAP {
     int w, h;
     uint8_t *data;
+    bool borrowed; /* data is owned by someone else, e.g. a mapped file, and is not freed */
 };
 
 struct ALGIF_ANIMATION {
@@ -34,7 +45,9 @@ struct ALGIF_ANIMATION {
     bool done = false; // if the gif finish display
     int display_index = 0; // the index of the current frame of gif
     int duration; // Duration of every frame
+    int *frame_end; // frame_end[i] is the end of frame i since the start of the animation, in 1/100th seconds
     ALLEGRO_BITMAP *store;
+    int lod = 0; /* frame bitmaps are downscaled by 2^lod, see algif_downscale */
 };
 
 struct ALGIF_FRAME {
@@ -47,12 +60,41 @@ struct ALGIF_FRAME {
 
     ALLEGRO_BITMAP *rendered;
 };
+/* Playback position of one user of an animation. Cursors never modify the
+ * shared ALGIF_ANIMATION, so every object can play the same GIF with its own
+ * clock.
+ */
+struct ALGIF_CURSOR {
+    int frame = 0; // index of the current frame
+    double time = 0; // seconds since the start of the current loop
+    int loops = 0; // number of finished loops
+    bool done = false; // if the gif finish display (only for gif with limited loops)
+};
+
 bool algif_draw_gif(ALGIF_ANIMATION *gif, double x, double y, int flip);
 ALGIF_ANIMATION *algif_load_raw(ALLEGRO_FILE *file);
+ALGIF_ANIMATION *algif_load_raw_memory(uint8_t const *data, size_t size);
 ALGIF_ANIMATION *algif_load_animation_f(ALLEGRO_FILE *file);
 ALGIF_ANIMATION *algif_load_animation(char const *filename);
+ALGIF_ANIMATION *algif_load_info(char const *filename);
+void algif_compute_timeline(ALGIF_ANIMATION *gif);
+void algif_release_frame_data(ALGIF_ANIMATION *gif);
+bool algif_compose_animation(ALGIF_ANIMATION *gif, uint32_t **pixels);
+ALGIF_ANIMATION *algif_decode_animation_f(ALLEGRO_FILE *file, uint32_t **pixels);
+ALGIF_ANIMATION *algif_decode_animation(char const *filename, uint32_t **pixels);
+void algif_upload_animation(ALGIF_ANIMATION *gif, uint32_t *pixels);
+void algif_upload_frames(ALGIF_ANIMATION *gif, uint32_t *pixels, int const *source);
+void algif_set_frame_allocator(ALGIF_FRAME_ALLOCATOR allocator, void *user);
+void algif_set_frame_expander(ALGIF_FRAME_EXPANDER expander, void *user);
+bool algif_expand_frame(ALGIF_ANIMATION const *gif, int frame, ALLEGRO_BITMAP *bitmap);
 void algif_render_frame(ALGIF_ANIMATION *gif, int frame, int xpos, int ypos);
+void algif_compose_frame(ALGIF_ANIMATION const *gif, int frame, uint32_t *canvas, uint32_t *store);
+bool algif_set_expand_path(ALGIF_EXPAND_PATH path);
 void algif_destroy_animation (ALGIF_ANIMATION *gif);
+int algif_lod_size(int size, int lod);
+int algif_frame_width(ALGIF_ANIMATION const *gif);
+int algif_frame_height(ALGIF_ANIMATION const *gif);
+void algif_downscale(uint32_t *pixels, int w, int h, int count, int lod);
 
 ALGIF_BITMAP *algif_create_bitmap(int w, int h);
 void algif_destroy_bitmap(ALGIF_BITMAP *bitmap);
@@ -61,5 +103,10 @@ void algif_blit(ALGIF_BITMAP *from, ALGIF_BITMAP *to, int xf, int yf, int xt, in
 ALLEGRO_BITMAP *algif_get_bitmap(ALGIF_ANIMATION *gif, double seconds);
 ALLEGRO_BITMAP *algif_get_frame_bitmap(ALGIF_ANIMATION *gif, int i);
 double algif_get_frame_duration(ALGIF_ANIMATION *gif, int i);
+int algif_frame_at(ALGIF_ANIMATION const *gif, double seconds);
+
+void algif_cursor_reset(ALGIF_CURSOR *cursor);
+void algif_cursor_advance(ALGIF_CURSOR *cursor, ALGIF_ANIMATION const *gif, double seconds);
+ALLEGRO_BITMAP *algif_cursor_bitmap(ALGIF_CURSOR const *cursor, ALGIF_ANIMATION *gif);
 
 #endif
\ No newline at end of file
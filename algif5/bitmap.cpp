@@ -9,7 +9,8 @@ ALGIF_BITMAP *algif_create_bitmap(int w, int h) {
 }
 
 void algif_destroy_bitmap(ALGIF_BITMAP *bitmap) {
-    free(bitmap->data);
+    if (!bitmap->borrowed)
+        free(bitmap->data);
     free(bitmap);
 }
 
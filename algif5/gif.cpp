@@ -1,9 +1,10 @@
 #include "algif.h"
 
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
-int LZW_decode (ALLEGRO_FILE * file, ALGIF_BITMAP *bmp);
+int LZW_decode_buffer (uint8_t const **data, uint8_t const *end, ALGIF_BITMAP *bmp);
 
 /* Destroy a complete gif, including all frames. */
 void algif_destroy_animation(ALGIF_ANIMATION *gif) {
@@ -21,18 +22,56 @@ void algif_destroy_animation(ALGIF_ANIMATION *gif) {
     if (gif->store)
         al_destroy_bitmap(gif->store);
     free (gif->frames);
+    free (gif->frame_end);
     free (gif);
 }
 
-static void read_palette (ALLEGRO_FILE * file, ALGIF_PALETTE *palette) {
+/* Cursor over a GIF file held in memory. Reads past the end return EOF. */
+typedef struct {
+    uint8_t const *pos, *end;
+} GIF_READER;
+
+static int read_u8 (GIF_READER *r)
+{
+    if (r->pos >= r->end)
+        return EOF;
+    return *r->pos++;
+}
+
+static int read_u16le (GIF_READER *r)
+{
+    int lo, hi;
+    if (r->end - r->pos < 2)
+    {
+        r->pos = r->end;
+        return EOF;
+    }
+    lo = r->pos[0];
+    hi = r->pos[1];
+    r->pos += 2;
+    return lo | (hi << 8);
+}
+
+static void skip (GIF_READER *r, int n)
+{
+    if (r->end - r->pos < n)
+        r->pos = r->end;
+    else
+        r->pos += n;
+}
+
+static bool read_palette (GIF_READER *r, ALGIF_PALETTE *palette) {
     int i;
 
+    if (r->end - r->pos < palette->colors_count * 3)
+        return false;
     for (i = 0; i < palette->colors_count; i++)
     {
-        palette->colors[i].r = al_fgetc (file);
-        palette->colors[i].g = al_fgetc (file);
-        palette->colors[i].b = al_fgetc (file);
+        palette->colors[i].r = *r->pos++;
+        palette->colors[i].g = *r->pos++;
+        palette->colors[i].b = *r->pos++;
     }
+    return true;
 }
 
 static void deinterlace (ALGIF_BITMAP *bmp)
@@ -59,10 +98,14 @@ static void deinterlace (ALGIF_BITMAP *bmp)
     algif_destroy_bitmap (n);
 }
 
-ALGIF_ANIMATION *algif_load_raw(ALLEGRO_FILE *file) {
-    if (!file)
+/* Parses a GIF file held in memory. Truncated or malformed files fail
+ * instead of being read past their end.
+ */
+ALGIF_ANIMATION *algif_load_raw_memory(uint8_t const *data, size_t size) {
+    if (!data)
         return NULL;
 
+    GIF_READER r = {data, data + size};
     int version;
     ALGIF_BITMAP *bmp = NULL;
     int i, j;
@@ -72,38 +115,39 @@ ALGIF_ANIMATION *algif_load_raw(ALLEGRO_FILE *file) {
     gif->frames_count = 0;
 
     /* is it really a GIF? */
-    if (al_fgetc (file) != 'G')
+    if (read_u8 (&r) != 'G')
         goto error;
-    if (al_fgetc (file) != 'I')
+    if (read_u8 (&r) != 'I')
         goto error;
-    if (al_fgetc (file) != 'F')
+    if (read_u8 (&r) != 'F')
         goto error;
-    if (al_fgetc (file) != '8')
+    if (read_u8 (&r) != '8')
         goto error;
     /* '7' or '9', for 87a or 89a. */
-    version = al_fgetc (file);
+    version = read_u8 (&r);
     if (version != '7' && version != '9')
         goto error;
-    if (al_fgetc (file) != 'a')
+    if (read_u8 (&r) != 'a')
         goto error;
 
-    gif->width = al_fread16le (file);
-    gif->height = al_fread16le (file);
-    i = al_fgetc (file);
+    gif->width = read_u16le (&r);
+    gif->height = read_u16le (&r);
+    i = read_u8 (&r);
     /* Global color table? */
     if (i & 128)
         gif->palette.colors_count = 1 << ((i & 7) + 1);
     else
         gif->palette.colors_count = 0;
     /* Background color is only valid with a global palette. */
-    gif->background_index = al_fgetc (file);
+    gif->background_index = read_u8 (&r);
 
     /* Skip aspect ratio. */
-    al_fseek (file, 1, ALLEGRO_SEEK_CUR);
+    skip (&r, 1);
 
     if (gif->palette.colors_count)
     {
-        read_palette (file, &gif->palette);
+        if (!read_palette (&r, &gif->palette))
+            goto error;
     }
 
     memset(&frame, 0, sizeof frame); /* For first frame. */
@@ -111,7 +155,7 @@ ALGIF_ANIMATION *algif_load_raw(ALLEGRO_FILE *file) {
 
     do
     {
-        i = al_fgetc (file);
+        i = read_u8 (&r);
 
         switch (i)
         {
@@ -120,20 +164,23 @@ ALGIF_ANIMATION *algif_load_raw(ALLEGRO_FILE *file) {
                 int w, h;
                 int interlaced = 0;
 
-                frame.xoff = al_fread16le (file);
-                frame.yoff = al_fread16le (file);
-                w = al_fread16le (file);
-                h = al_fread16le (file);
+                frame.xoff = read_u16le (&r);
+                frame.yoff = read_u16le (&r);
+                w = read_u16le (&r);
+                h = read_u16le (&r);
+                i = read_u8 (&r);
+                if (i == EOF)
+                    goto error;
                 bmp = algif_create_bitmap (w, h);
                 if (!bmp)
                     goto error;
-                i = al_fgetc (file);
 
                 /* Local palette. */
                 if (i & 128)
                 {
                     frame.palette.colors_count = 1 << ((i & 7) + 1);
-                    read_palette (file, &frame.palette);
+                    if (!read_palette (&r, &frame.palette))
+                        goto error;
                 }
                 else
                 {
@@ -143,7 +190,7 @@ ALGIF_ANIMATION *algif_load_raw(ALLEGRO_FILE *file) {
                 if (i & 64)
                     interlaced = 1;
 
-                if (LZW_decode (file, bmp))
+                if (LZW_decode_buffer (&r.pos, r.end, bmp))
                     goto error;
 
                 if (interlaced)
@@ -164,70 +211,108 @@ ALGIF_ANIMATION *algif_load_raw(ALLEGRO_FILE *file) {
                 break;
             }
             case 0x21: /* Extension Introducer. */
-                j = al_fgetc (file); /* Extension Type. */
-                i = al_fgetc (file); /* Size. */
+                j = read_u8 (&r); /* Extension Type. */
+                i = read_u8 (&r); /* Size. */
                 if (j == 0xf9) /* Graphic Control Extension. */
                 {
                     /* size must be 4 */
                     if (i != 4)
                         goto error;
-                    i = al_fgetc (file);
+                    i = read_u8 (&r);
                     frame.disposal_method = (i >> 2) & 7;
-                    frame.duration = al_fread16le (file);
+                    frame.duration = read_u16le (&r);
                     if (i & 1)  /* Transparency? */
                     {
-                        frame.transparent_index = al_fgetc (file);
+                        frame.transparent_index = read_u8 (&r);
                     }
                     else
                     {
-                        al_fseek (file, 1, ALLEGRO_SEEK_CUR);
+                        skip (&r, 1);
                         frame.transparent_index = -1;
                     }
-                    i = al_fgetc (file); /* Size. */
+                    i = read_u8 (&r); /* Size. */
                 }
                 /* Application Extension. */
                 else if (j == 0xff)
                 {
                     if (i == 11)
                     {
-                        char name[12];
-                        al_fread (file, name, 11);
-                        i = al_fgetc (file); /* Size. */
-                        name[11] = '\0';
+                        char name[12] = {0};
+                        if (r.end - r.pos >= 11)
+                            memcpy (name, r.pos, 11);
+                        skip (&r, 11);
+                        i = read_u8 (&r); /* Size. */
                         if (!strcmp (name, "NETSCAPE2.0"))
                         {
                             if (i == 3)
                             {
-                                j = al_fgetc (file);
-                                gif->loop = al_fread16le (file);
+                                j = read_u8 (&r);
+                                gif->loop = read_u16le (&r);
                                 if (j != 1)
                                     gif->loop = 0;
-                                i = al_fgetc (file); /* Size. */
+                                i = read_u8 (&r); /* Size. */
                             }
                         }
                     }
                 }
 
                 /* Possibly more blocks until terminator block (0). */
-                while (i)
+                while (i > 0)
                 {
-                    al_fseek (file, i, ALLEGRO_SEEK_CUR);
-                    i = al_fgetc (file);
+                    skip (&r, i);
+                    i = read_u8 (&r);
                 }
+                if (i == EOF)
+                    goto error;
                 break;
             case 0x3b:
                 /* GIF Trailer. */
-                al_fclose (file);
                 return gif;
+            case EOF:
+                goto error;
         }
     }
     while (true);
   error:
-    if (file)
-        al_fclose (file);
     if (gif)
         algif_destroy_animation (gif);
     if (bmp)
         algif_destroy_bitmap (bmp);
     return NULL;
 }
+
+/* Reads the whole file into memory and parses it. The file is closed. */
+ALGIF_ANIMATION *algif_load_raw(ALLEGRO_FILE *file) {
+    if (!file)
+        return NULL;
+
+    int64_t hint = al_fsize (file);
+    /* One spare byte, so that a correct hint ends the loop after one read. */
+    size_t capacity = hint > 0 ? (size_t)hint + 1 : 64 * 1024;
+    size_t size = 0;
+    uint8_t *data = (uint8_t*)malloc (capacity);
+    ALGIF_ANIMATION *gif = NULL;
+
+    while (data)
+    {
+        size_t n = al_fread (file, data + size, capacity - size);
+        size += n;
+        if (size < capacity)
+            break;
+        /* The size hint was wrong or unknown: grow and keep reading. */
+        uint8_t *grown = (uint8_t*)realloc (data, capacity * 2);
+        if (!grown)
+        {
+            free (data);
+            data = NULL;
+            break;
+        }
+        data = grown;
+        capacity *= 2;
+    }
+    al_fclose (file);
+    if (data)
+        gif = algif_load_raw_memory (data, size);
+    free (data);
+    return gif;
+}
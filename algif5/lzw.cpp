@@ -1,145 +1,228 @@
 #include "algif.h"
 
-static int
-read_code (ALLEGRO_FILE * file, char *buf, int *bit_pos, int bit_size)
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define LZW_MAX_CODES 4096 /* Maximum bit size is 12. */
+
+/* Bit reservoir over the data sub-blocks of an image. Codes are packed LSB
+ * first across the sub-blocks, so the length bytes are skipped while refilling.
+ */
+typedef struct {
+    uint8_t const *pos, *end;
+    int block_left; /* bytes left in the current sub-block */
+    bool blocks_done; /* the block terminator has been read */
+    uint64_t bits;
+    int bit_count;
+} LZW_READER;
+
+static void refill (LZW_READER *r)
 {
-    int i;
-    int code = 0;
-    int pos = 1;
-
-    for (i = 0; i < bit_size; i++)
-    {
-        int byte_pos = (*bit_pos >> 3) & 255;
-
-        if (byte_pos == 0)
-        {
-            int data_len = al_fgetc (file);
-
-            if (data_len == 0)
-            {
-                //printf ("Fatal. Errorneous GIF stream.\n");
-                //abort ();
-                return -1;
+    while (r->bit_count <= 56) {
+        if (r->block_left == 0) {
+            if (r->blocks_done || r->pos >= r->end) {
+                r->blocks_done = true;
+                return;
+            }
+            r->block_left = *r->pos++;
+            if (r->block_left == 0) {
+                r->blocks_done = true;
+                return;
             }
-            al_fread (file, buf + 256 - data_len, data_len);
-            byte_pos = 256 - data_len;
-            *bit_pos = byte_pos << 3;
         }
-        if (buf[byte_pos] & (1 << (*bit_pos & 7)))
-            code += pos;
-        pos += pos;
-        (*bit_pos)++;
+        if (r->pos >= r->end) {
+            r->blocks_done = true;
+            r->block_left = 0;
+            return;
+        }
+        r->bits |= (uint64_t)*r->pos++ << r->bit_count;
+        r->bit_count += 8;
+        r->block_left--;
+    }
+}
+
+static int read_code (LZW_READER *r, int bit_size)
+{
+    int code;
+    if (r->bit_count < bit_size) {
+        refill (r);
+        if (r->bit_count < bit_size)
+            return -1;
     }
+    code = (int)(r->bits & ((1u << bit_size) - 1));
+    r->bits >>= bit_size;
+    r->bit_count -= bit_size;
     return code;
 }
 
-int
-LZW_decode (ALLEGRO_FILE * file, ALGIF_BITMAP *bmp)
+/* Moves the reader past the block terminator of the image data. */
+static void skip_blocks (LZW_READER *r)
 {
-    int orig_bit_size;
-    char buf[256];
-    int bit_size;
-    int bit_pos;
-    int clear_marker;
-    int end_marker;
-    struct
-    {
-        int prefix;
-        int c;
-        int len;
+    r->pos += r->block_left;
+    while (!r->blocks_done && r->pos < r->end) {
+        int len = *r->pos++;
+        if (len == 0)
+            break;
+        r->pos += len;
     }
-    codes[4096];                /* Maximum bit size is 12. */
-    int n;
-    int i, prev, code, c;
-    int out_pos = 0;
+    if (r->pos > r->end)
+        r->pos = r->end;
+}
 
-    orig_bit_size = al_fgetc (file);
-    n = 2 + (1 << orig_bit_size);
+/* Decodes the LZW image data starting at *data (the minimum code size byte)
+ * into bmp, and advances *data past the block terminator.
+ * Every code is stored as the offset and length of its first occurrence in
+ * the output, so expanding a code is a single copy of earlier output instead
+ * of a walk through the prefix chain. Output beyond the size of bmp and codes
+ * beyond the 4096 entry table are ignored.
+ */
+int
+LZW_decode_buffer (uint8_t const **data, uint8_t const *end, ALGIF_BITMAP *bmp)
+{
+    int offset[LZW_MAX_CODES];
+    int length[LZW_MAX_CODES];
+    LZW_READER r;
+    uint8_t *out = bmp->data;
+    int out_size = bmp->w * bmp->h;
+    int out_pos = 0;
+    int orig_bit_size, bit_size;
+    int clear_marker, end_marker;
+    int n, code;
+    int prev, prev_pos = 0, prev_len = 0;
 
-    for (i = 0; i < n; i++)
-    {
-        codes[i].c = i;
-        codes[i].len = 0;
-    }
+    if (*data >= end)
+        return -1;
+    orig_bit_size = *(*data)++;
+    if (orig_bit_size < 1 || orig_bit_size > 11)
+        return -1;
 
-    clear_marker = n - 2;
-    end_marker = n - 1;
+    r.pos = *data;
+    r.end = end;
+    r.block_left = 0;
+    r.blocks_done = false;
+    r.bits = 0;
+    r.bit_count = 0;
 
+    clear_marker = 1 << orig_bit_size;
+    end_marker = clear_marker + 1;
+    n = clear_marker + 2;
     bit_size = orig_bit_size + 1;
 
-    bit_pos = 0;
-
-    /* Expect to read clear code as first code here. */
-    prev = read_code (file, buf, &bit_pos, bit_size);
-    //printf("%d %d = %d\n", bit_pos, bit_size, prev);
-    if (prev == -1)
-        return -1;
-    do
+    /* The stream should start with a clear code. Act as if it did. */
+    prev = clear_marker;
+    while (1)
     {
-        code = read_code (file, buf, &bit_pos, bit_size);
-        //printf("%d %d = %d\n", bit_pos, bit_size, code);
+        int len;
+        code = read_code (&r, bit_size);
         if (code == -1)
             return -1;
         if (code == clear_marker)
         {
-            bit_size = orig_bit_size;
-            n = 1 << bit_size;
-            n += 2;
-            bit_size++;
+            n = clear_marker + 2;
+            bit_size = orig_bit_size + 1;
             prev = code;
             continue;
         }
-
         if (code == end_marker)
             break;
 
-        /* Known code: ok. Else: must be doubled char. */
-        if (code < n)
-            c = code;
-        else
-            c = prev;
-
-        /* Output the code. */
-        out_pos += codes[c].len;
-        i = 0;
-        do
+        if (code < clear_marker)
         {
-            bmp->data[out_pos - i] = codes[c].c;
-            if (codes[c].len)
-                c = codes[c].prefix;
-            else
-                break;
-            i++;
+            /* Root code: a single index. */
+            len = 1;
+            if (out_pos < out_size)
+                out[out_pos] = (uint8_t)code;
         }
-        while (1);
-
-        out_pos++;
-
-        /* Unknown code -> must be double char. */
-        if (code >= n)
+        else if (code < n)
         {
-            bmp->data[out_pos] = codes[c].c;
-            out_pos++;
+            len = length[code];
+            if (out_pos + len > out_size)
+                len = out_size - out_pos;
+            memcpy (out + out_pos, out + offset[code], len);
         }
-
-        /* Except after clear marker, build new code. */
-        if (prev != clear_marker)
+        else if (code == n && prev != clear_marker)
         {
-            codes[n].prefix = prev;
-            codes[n].len = codes[prev].len + 1;
-            codes[n].c = codes[c].c;
-            n++;
+            /* Unknown code -> must be the previous string doubling its first index. */
+            len = prev_len + 1;
+            if (out_pos + len > out_size)
+                len = out_size - out_pos;
+            if (len > 0)
+            {
+                memcpy (out + out_pos, out + prev_pos, len < prev_len ? len : prev_len);
+                if (len > prev_len)
+                    out[out_pos + prev_len] = out[prev_pos];
+            }
+        }
+        else
+        {
+            /* Corrupt stream: keep what has been decoded. */
+            break;
         }
 
-        /* Out of bits? Increase. */
-        if (n == (1 << bit_size))
+        /* Except after clear marker, build new code: the previous string
+         * followed by the first index of this one, which is exactly the output
+         * starting at the previous string.
+         */
+        if (prev != clear_marker && n < LZW_MAX_CODES)
         {
-            if (bit_size < 12)
+            offset[n] = prev_pos;
+            length[n] = prev_len + 1;
+            n++;
+            /* Out of bits? Increase. */
+            if (n == (1 << bit_size) && bit_size < 12)
                 bit_size++;
         }
 
         prev = code;
+        prev_pos = out_pos;
+        prev_len = len;
+        out_pos += len;
+        if (out_pos >= out_size)
+            break;
     }
-    while (1);
+    skip_blocks (&r);
+    *data = r.pos;
     return 0;
 }
+
+/* Reads the LZW image data of a frame from file and decodes it into bmp. */
+int
+LZW_decode (ALLEGRO_FILE * file, ALGIF_BITMAP *bmp)
+{
+    size_t size = 0, capacity = 4096;
+    uint8_t *buffer = (uint8_t *)malloc (capacity);
+    uint8_t const *pos;
+    int c, result;
+
+    if (!buffer)
+        return -1;
+    /* Minimum code size, then the sub-blocks up to the terminator. */
+    c = al_fgetc (file);
+    while (c != EOF)
+    {
+        if (size + 256 > capacity)
+        {
+            uint8_t *grown = (uint8_t *)realloc (buffer, capacity * 2);
+            if (!grown)
+            {
+                free (buffer);
+                return -1;
+            }
+            buffer = grown;
+            capacity *= 2;
+        }
+        buffer[size++] = (uint8_t)c;
+        if (size > 1)
+        {
+            if (c == 0)
+                break;
+            size += al_fread (file, buffer + size, c);
+        }
+        c = al_fgetc (file);
+    }
+    pos = buffer;
+    result = LZW_decode_buffer (&pos, buffer + size, bmp);
+    free (buffer);
+    return result;
+}
@@ -0,0 +1,215 @@
+#include "AtlasCenter.h"
+#include <allegro5/allegro.h>
+#include <algorithm>
+#include <cstring>
+#include "../Utils.h"
+#include "../algif5/algif.h"
+#include "DataCenter.h"
+
+static ALLEGRO_BITMAP *allocate_gif_frame(int w, int h, void *user) {
+	return static_cast<AtlasCenter*>(user)->allocate(w, h);
+}
+
+AtlasCenter::~AtlasCenter() {
+	for(Page &page : pages)
+		al_destroy_bitmap(page.bitmap);
+}
+
+/**
+ * @brief Enable the atlas for the current display, and let every GIF frame uploaded from now on be allocated in it.
+ * @details Must be called after the display is created and before the resources are loaded. Does nothing in headless mode.
+ */
+void
+AtlasCenter::init() {
+	ALLEGRO_DISPLAY *display = al_get_current_display();
+	if(DataCenter::get_instance()->headless || !display) return;
+	int max_size = al_get_display_option(display, ALLEGRO_MAX_BITMAP_SIZE);
+	if(max_size > 0) size = std::min(size, max_size);
+	enabled = true;
+	algif_set_frame_allocator(allocate_gif_frame, this);
+	debug_log("<AtlasCenter> atlas pages of %dx%d.\n", size, size);
+}
+
+/**
+ * @brief Reserve a w x h area in an atlas page.
+ * @return A sub-bitmap of the page, or nullptr if the atlas is disabled, the size is too large or drawing is held. The content of the area is transparent.
+ */
+ALLEGRO_BITMAP*
+AtlasCenter::allocate(int w, int h) {
+	// The area is about to be written, which is not allowed while drawing is held.
+	if(!enabled || w <= 0 || h <= 0 || al_is_bitmap_drawing_held()) return nullptr;
+	if(w > AtlasSetting::max_sprite_size || h > AtlasSetting::max_sprite_size) return nullptr;
+	int x, y;
+	Page *reused;
+	if(reuse(w, h, reused, x, y)) {
+		++reused->live;
+		return al_create_sub_bitmap(reused->bitmap, x, y, w, h);
+	}
+	for(Page &page : pages) {
+		if(place(page, w, h, x, y)) {
+			++page.live;
+			return al_create_sub_bitmap(page.bitmap, x, y, w, h);
+		}
+	}
+	if(!add_page() || !place(pages.back(), w, h, x, y)) return nullptr;
+	++pages.back().live;
+	return al_create_sub_bitmap(pages.back().bitmap, x, y, w, h);
+}
+
+/**
+ * @brief Move a loaded bitmap into the atlas.
+ * @details On success the original bitmap is destroyed. Otherwise it is returned unchanged.
+ * @return The bitmap to be used from now on.
+ */
+ALLEGRO_BITMAP*
+AtlasCenter::pack(ALLEGRO_BITMAP *bitmap) {
+	ALLEGRO_BITMAP *sub = allocate(al_get_bitmap_width(bitmap), al_get_bitmap_height(bitmap));
+	if(!sub) return bitmap;
+	ALLEGRO_STATE state;
+	al_store_state(&state, ALLEGRO_STATE_TARGET_BITMAP | ALLEGRO_STATE_BLENDER);
+	al_set_target_bitmap(sub);
+	al_set_blender(ALLEGRO_ADD, ALLEGRO_ONE, ALLEGRO_ZERO);
+	al_draw_bitmap(bitmap, 0, 0, 0);
+	al_restore_state(&state);
+	al_destroy_bitmap(bitmap);
+	return sub;
+}
+
+/**
+ * @brief Create a bitmap from w x h pixels in ALLEGRO_PIXEL_FORMAT_ABGR_8888, in the atlas if it fits there.
+ * @details Must run on the main thread, since it creates a bitmap.
+ * @return The bitmap, or nullptr if it cannot be created.
+ */
+ALLEGRO_BITMAP*
+AtlasCenter::upload(const uint32_t *pixels, int w, int h) {
+	ALLEGRO_BITMAP *bitmap = allocate(w, h);
+	if(!bitmap) bitmap = al_create_bitmap(w, h);
+	if(!bitmap) return nullptr;
+	ALLEGRO_LOCKED_REGION *lr = al_lock_bitmap(bitmap, ALLEGRO_PIXEL_FORMAT_ABGR_8888, ALLEGRO_LOCK_WRITEONLY);
+	if(!lr) {
+		release(bitmap);
+		return nullptr;
+	}
+	size_t row = sizeof(uint32_t) * w;
+	for(int y = 0; y < h; ++y)
+		memcpy(static_cast<uint8_t*>(lr->data) + static_cast<ptrdiff_t>(y) * lr->pitch, pixels + static_cast<size_t>(y) * w, row);
+	al_unlock_bitmap(bitmap);
+	return bitmap;
+}
+
+/**
+ * @brief Destroy a bitmap returned by allocate(), pack() or upload(). Bitmaps that are not in the atlas are destroyed as usual.
+ * @details The area of the bitmap can be allocated again. The page of the bitmap is destroyed when its last sub-bitmap is released.
+ */
+void
+AtlasCenter::release(ALLEGRO_BITMAP *bitmap) {
+	if(!bitmap) return;
+	ALLEGRO_BITMAP *parent = al_is_sub_bitmap(bitmap) ? al_get_parent_bitmap(bitmap) : nullptr;
+	Area area{0, 0, 0, 0};
+	if(parent) area = Area{al_get_bitmap_x(bitmap), al_get_bitmap_y(bitmap), al_get_bitmap_width(bitmap) + AtlasSetting::padding, al_get_bitmap_height(bitmap) + AtlasSetting::padding};
+	al_destroy_bitmap(bitmap);
+	if(!parent) return;
+	auto it = std::find_if(pages.begin(), pages.end(), [parent](const Page &page) { return page.bitmap == parent; });
+	if(it == pages.end()) return;
+	if(--it->live > 0) {
+		free_area(*it, area);
+		return;
+	}
+	al_destroy_bitmap(it->bitmap);
+	pages.erase(it);
+	debug_log("<AtlasCenter> empty atlas page destroyed, %zu left.\n", pages.size());
+}
+
+/**
+ * @brief Find the smallest released area that fits w x h (plus padding), and take it.
+ * @details The rest of the area is split into the part on the right and the part below, which stay free. The taken part is cleared, since it still holds the pixels of the released sub-bitmap.
+ */
+bool
+AtlasCenter::reuse(int w, int h, Page *&page, int &x, int &y) {
+	int pw = w + AtlasSetting::padding, ph = h + AtlasSetting::padding;
+	page = nullptr;
+	size_t best = 0;
+	long best_area = 0;
+	for(Page &candidate : pages) {
+		for(size_t i = 0; i < candidate.free.size(); ++i) {
+			const Area &area = candidate.free[i];
+			if(area.w < pw || area.h < ph) continue;
+			long a = static_cast<long>(area.w) * area.h;
+			if(!page || a < best_area) {
+				page = &candidate;
+				best = i;
+				best_area = a;
+			}
+		}
+	}
+	if(!page) return false;
+	Area area = page->free[best];
+	x = area.x;
+	y = area.y;
+	// The padding is cleared as well, so that filtering never samples what was there.
+	ALLEGRO_LOCKED_REGION *lr = al_lock_bitmap_region(page->bitmap, x, y, pw, ph, ALLEGRO_PIXEL_FORMAT_ABGR_8888, ALLEGRO_LOCK_WRITEONLY);
+	if(!lr) return false;
+	for(int row = 0; row < ph; ++row)
+		memset(static_cast<uint8_t*>(lr->data) + static_cast<ptrdiff_t>(row) * lr->pitch, 0, sizeof(uint32_t) * pw);
+	al_unlock_bitmap(page->bitmap);
+	page->free.erase(page->free.begin() + best);
+	if(area.w > pw) page->free.emplace_back(Area{area.x + pw, area.y, area.w - pw, ph});
+	if(area.h > ph) page->free.emplace_back(Area{area.x, area.y + ph, area.w, area.h - ph});
+	return true;
+}
+
+/**
+ * @brief Add an area to the free list of a page, merged with the free areas it borders along a whole side.
+ */
+void
+AtlasCenter::free_area(Page &page, Area area) {
+	for(size_t i = 0; i < page.free.size(); ) {
+		const Area &other = page.free[i];
+		bool beside = other.y == area.y && other.h == area.h && (other.x + other.w == area.x || area.x + area.w == other.x);
+		bool above = other.x == area.x && other.w == area.w && (other.y + other.h == area.y || area.y + area.h == other.y);
+		if(!beside && !above) {
+			++i;
+			continue;
+		}
+		area = Area{std::min(area.x, other.x), std::min(area.y, other.y), beside ? area.w + other.w : area.w, above ? area.h + other.h : area.h};
+		page.free.erase(page.free.begin() + i);
+		// The merged area may now border areas that were visited already.
+		i = 0;
+	}
+	page.free.emplace_back(area);
+}
+
+/**
+ * @brief Find room for a w x h area (plus padding) on the current shelf of the page, or on a new shelf below it.
+ */
+bool
+AtlasCenter::place(Page &page, int w, int h, int &x, int &y) {
+	int pw = w + AtlasSetting::padding, ph = h + AtlasSetting::padding;
+	int shelf_x = page.shelf_x, shelf_y = page.shelf_y, shelf_h = page.shelf_h;
+	if(shelf_x + pw > size) {
+		shelf_y += shelf_h;
+		shelf_x = 0;
+		shelf_h = 0;
+	}
+	if(shelf_x + pw > size || shelf_y + ph > size) return false;
+	x = shelf_x;
+	y = shelf_y;
+	page.shelf_x = shelf_x + pw;
+	page.shelf_y = shelf_y;
+	page.shelf_h = std::max(shelf_h, ph);
+	return true;
+}
+
+bool
+AtlasCenter::add_page() {
+	ALLEGRO_BITMAP *bitmap = al_create_bitmap(size, size);
+	if(!bitmap) return false;
+	ALLEGRO_STATE state;
+	al_store_state(&state, ALLEGRO_STATE_TARGET_BITMAP);
+	al_set_target_bitmap(bitmap);
+	al_clear_to_color(al_map_rgba(0, 0, 0, 0));
+	al_restore_state(&state);
+	pages.emplace_back(Page{bitmap, 0, 0, 0, 0, {}});
+	debug_log("<AtlasCenter> atlas page %zu created.\n", pages.size());
+	return true;
+}
@@ -0,0 +1,77 @@
+#ifndef ATLASCENTER_H_INCLUDED
+#define ATLASCENTER_H_INCLUDED
+
+#include <vector>
+#include <cstdint>
+#include <allegro5/bitmap.h>
+
+// fixed settings
+namespace AtlasSetting {
+	/**
+	 * @brief Width and height of an atlas page. Smaller if the display does not support it.
+	 */
+	constexpr int page_size = 2048;
+	/**
+	 * @brief Bitmaps larger than this in either dimension keep their own texture, e.g. full screen backgrounds.
+	 */
+	constexpr int max_sprite_size = 512;
+	/**
+	 * @brief Transparent gap between packed bitmaps, so that filtering never samples a neighbour.
+	 */
+	constexpr int padding = 1;
+};
+
+/**
+ * @brief Packs sprites into a few large textures.
+ * @details Frames of GIFs and small images are placed in atlas pages by a shelf packer and handed out as sub-bitmaps. Consecutive draws of sub-bitmaps from the same page are merged into one draw call while drawing is held with al_hold_bitmap_drawing.
+ * @details The area of a released sub-bitmap goes to a free list of its page and is reused by later allocations, so evicting and loading sprites again does not grow the atlas. A page is destroyed once all of its sub-bitmaps are released.
+ * @details The atlas is disabled in headless mode and before init() is called. Bitmaps are then not packed at all.
+ */
+class AtlasCenter
+{
+public:
+	static AtlasCenter *get_instance() {
+		static AtlasCenter AC;
+		return &AC;
+	}
+	~AtlasCenter();
+	void init();
+	ALLEGRO_BITMAP *allocate(int w, int h);
+	ALLEGRO_BITMAP *pack(ALLEGRO_BITMAP *bitmap);
+	ALLEGRO_BITMAP *upload(const uint32_t *pixels, int w, int h);
+	void release(ALLEGRO_BITMAP *bitmap);
+	size_t page_count() const { return pages.size(); }
+private:
+	AtlasCenter() {}
+	/**
+	 * @brief An area of a page, padding included.
+	 */
+	struct Area {
+		int x, y, w, h;
+	};
+	/**
+	 * @brief An atlas page filled shelf by shelf, from top to bottom and left to right.
+	 */
+	struct Page {
+		ALLEGRO_BITMAP *bitmap;
+		int shelf_x, shelf_y, shelf_h;
+		/**
+		 * @brief Number of sub-bitmaps of the page that are not released yet.
+		 */
+		int live;
+		/**
+		 * @brief Released areas of the page, not overlapping each other.
+		 */
+		std::vector<Area> free;
+	};
+	bool reuse(int w, int h, Page *&page, int &x, int &y);
+	bool place(Page &page, int w, int h, int &x, int &y);
+	static void free_area(Page &page, Area area);
+	bool add_page();
+private:
+	bool enabled = false;
+	int size = AtlasSetting::page_size;
+	std::vector<Page> pages;
+};
+
+#endif
@@ -9,19 +9,30 @@
 #include "../Hero.h"
 #include "../sun.h"
 //revise end
+#include "MemoryCenter.h"
 
 // fixed settings
 namespace DataSetting {
 	constexpr double FPS = 60;
+	constexpr double draw_FPS = 60;
 	constexpr int window_width = 1264;
 	constexpr int window_height = 628;
 	constexpr int game_field_length = 1100;
 }
 
-DataCenter::DataCenter() {
+DataCenter::DataCenter() :
+	monsters(Monster::pool_slot_size()),
+	towers(Tower::pool_slot_size()),
+	towerBullets(sizeof(Bullet)),
+	suns(sizeof(Sun)) {
 	this->FPS = DataSetting::FPS;
+	this->draw_FPS = DataSetting::draw_FPS;
+	this->render_alpha = 1;
+	this->headless = false;
 	this->window_width = DataSetting::window_width;
 	this->window_height = DataSetting::window_height;
+	this->display_scale = 1;
+	this->lod = 0;
 	this->game_field_length = DataSetting::game_field_length;
 	memset(key_state, false, sizeof(key_state));
 	memset(prev_key_state, false, sizeof(prev_key_state));
@@ -35,26 +46,16 @@ DataCenter::DataCenter() {
 		heros.emplace_back(new Hero());
 	}
 	//revise end
+	// Towers, bullets and suns unpin their GIFs when the pools are destroyed. Creating MemoryCenter here makes it outlive DataCenter.
+	MemoryCenter::get_instance();
 }
 
 DataCenter::~DataCenter() {
 	delete player;
 	delete level;
-	for(Monster *&m : monsters) {
-		delete m;
-	}
-	for(Tower *&t : towers) {
-		delete t;
-	}
-	for(Bullet *&b : towerBullets) {
-		delete b;
-	}
 	for(Hero *&h : heros) {
 		delete h;
 	}
-	for(Sun *&s : suns) {  
-        delete s;
-    }
 }
 
 void DataCenter::reset(){
@@ -66,9 +67,6 @@ void DataCenter::reset(){
     level = new Level();
 
     // 清空怪物列表
-    for (Monster* monster : monsters) {
-        delete monster;
-    }
     monsters.clear();
 
     // 重置英雄数据
@@ -78,8 +76,7 @@ void DataCenter::reset(){
     }
 
     // 其他资源的重置逻辑...
-	 for (Tower* tower : towers) {
-        delete tower;
-    }
-    towers.clear();
+	towers.clear();
+	towerBullets.clear();
+	suns.clear();
 }
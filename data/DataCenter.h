@@ -6,6 +6,7 @@
 #include <allegro5/keycodes.h>
 #include <allegro5/mouse.h>
 #include "../shapes/Point.h"
+#include "ObjectPool.h"
 
 class Sun;
 class Player;
@@ -33,8 +34,39 @@ public:
 	~DataCenter();
 public:
 	void reset();
+	/**
+	 * @brief Simulation tick rate. Every game_update advances the game by exactly 1/FPS seconds.
+	 * @see Game::execute()
+	 */
 	double FPS;
+	/**
+	 * @brief Drawing rate, independent of the simulation tick rate.
+	 */
+	double draw_FPS;
+	/**
+	 * @brief Progress from the previous simulation tick (0) to the current one (1) at drawing time.
+	 * @details Moving objects are drawn in between their positions of the last two ticks by this ratio.
+	 * @see Object::draw_x(double alpha) const
+	 */
+	double render_alpha;
+	/**
+	 * @brief Whether the game runs without display, audio and timer.
+	 * @details Headless mode is used to simulate levels as fast as possible. Asset centers only provide the metadata (size, frame durations) that the simulation needs.
+	 * @see Game::simulate(int lvl, int max_ticks)
+	 */
+	bool headless;
 	int window_width, window_height;
+	/**
+	 * @brief Size of the display relative to the window size. The game is laid out in window coordinates, and drawn scaled by this factor.
+	 * @details Set with --scale, and reduced further if the scaled window does not fit the monitor.
+	 * @see Game::Game()
+	 */
+	double display_scale;
+	/**
+	 * @brief Level of detail of the sprites: images and GIF frames are stored at 1/2^lod of their size. Chosen from display_scale before any sprite is loaded, and 0 in headless mode.
+	 * @see LOD
+	 */
+	int lod;
 	/**
 	 * @brief The width and height of game area (not window size). That is, the region excludes menu region.
 	 * @details The game area is sticked to the top-left of the display window.
@@ -83,24 +115,24 @@ public:
 	 */
 	Level *level;
 	/**
-	 * @brief Raw list of Monster objects.
-	 * @see Monster
+	 * @brief Pool of Monster objects.
+	 * @see Monster::create_monster(MonsterType type, const std::vector<Point> &path)
 	 */
-	std::vector<Monster*> monsters;
+	ObjectPool<Monster> monsters;
 	/**
-	 * @brief Raw list of Tower objects.
-	 * @see Tower
+	 * @brief Pool of planted Tower objects.
+	 * @see Tower::plant_tower(TowerType type, const Point &p)
 	 */
-	std::vector<Tower*> towers;
+	ObjectPool<Tower> towers;
 	/**
-	 * @brief Raw list of Bullet objects.
+	 * @brief Pool of Bullet objects.
 	 * @see Bullet
 	 */
-	std::vector<Bullet*> towerBullets;
+	ObjectPool<Bullet> towerBullets;
 	//revise start
 	std::vector<Hero*> heros;
 	//revise end
-	std::vector<Sun*> suns;
+	ObjectPool<Sun> suns;
 private:
 	DataCenter();
 };
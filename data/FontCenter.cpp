@@ -1,5 +1,7 @@
 #include "FontCenter.h"
 #include <allegro5/allegro_ttf.h>
+#include <string>
+#include "../Benchmark.h"
 
 // fixed settings
 namespace FontSetting {
@@ -9,9 +11,14 @@ namespace FontSetting {
 
 void
 FontCenter::init() {
+	StartupProfile *SP = StartupProfile::get_instance();
 	for(const int &fs : FontSize::list) {
+		double start = StartupProfile::now();
 		caviar_dreams[fs] = al_load_ttf_font(FontSetting::caviar_dreams_font_path, fs, 0);
+		double middle = StartupProfile::now();
 		courier_new[fs] = al_load_ttf_font(FontSetting::courier_new_font_path, fs, 0);
+		SP->record("font", std::string(FontSetting::caviar_dreams_font_path) + " @" + std::to_string(fs), middle - start);
+		SP->record("font", std::string(FontSetting::courier_new_font_path) + " @" + std::to_string(fs), StartupProfile::now() - middle);
 	}
 }
 
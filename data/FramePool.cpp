@@ -0,0 +1,69 @@
+#include "FramePool.h"
+#include <allegro5/allegro.h>
+#include "../Utils.h"
+
+FramePool::~FramePool() {
+	for(Entry &entry : lru)
+		al_destroy_bitmap(entry.bitmap);
+}
+
+/**
+ * @brief Get the bitmap of a frame, expanding it if it is not in the pool.
+ * @details Expanding writes to a bitmap, so drawing is released during it if it is held. The bitmap stays valid at least until the next call.
+ * @return The bitmap, or nullptr if no bitmap can be created.
+ */
+ALLEGRO_BITMAP*
+FramePool::get(const ALGIF_ANIMATION *gif, int frame) {
+	Key key{gif, frame};
+	std::map<Key, std::list<Entry>::iterator>::iterator it = index.find(key);
+	if(it != index.end()) {
+		lru.splice(lru.begin(), lru, it->second);
+		return it->second->bitmap;
+	}
+	bool held = al_is_bitmap_drawing_held();
+	if(held) al_hold_bitmap_drawing(false);
+	int w = algif_frame_width(gif), h = algif_frame_height(gif);
+	size_t bytes = sizeof(uint32_t) * w * h;
+	ALLEGRO_BITMAP *bitmap = nullptr;
+	while(!lru.empty() && used + bytes > capacity) {
+		Entry &last = lru.back();
+		if(!bitmap && al_get_bitmap_width(last.bitmap) == w && al_get_bitmap_height(last.bitmap) == h) {
+			bitmap = last.bitmap;
+			last.bitmap = nullptr;
+		}
+		pop_back();
+	}
+	if(!bitmap) bitmap = al_create_bitmap(w, h);
+	if(bitmap) {
+		if(!algif_expand_frame(gif, frame, bitmap))
+			debug_log("<FramePool> cannot expand a frame of %dx%d.\n", w, h);
+		lru.push_front(Entry{key, bitmap, bytes});
+		index[key] = lru.begin();
+		used += bytes;
+	}
+	if(held) al_hold_bitmap_drawing(true);
+	return bitmap;
+}
+
+/**
+ * @brief Destroy the expanded frames of an animation. Must be called before the animation is destroyed, since a new animation may get its address.
+ */
+void
+FramePool::erase(const ALGIF_ANIMATION *gif) {
+	std::map<Key, std::list<Entry>::iterator>::iterator it = index.lower_bound(Key{gif, 0});
+	while(it != index.end() && it->first.first == gif) {
+		al_destroy_bitmap(it->second->bitmap);
+		used -= it->second->bytes;
+		lru.erase(it->second);
+		it = index.erase(it);
+	}
+}
+
+void
+FramePool::pop_back() {
+	Entry &last = lru.back();
+	if(last.bitmap) al_destroy_bitmap(last.bitmap);
+	used -= last.bytes;
+	index.erase(last.key);
+	lru.pop_back();
+}
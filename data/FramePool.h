@@ -0,0 +1,41 @@
+#ifndef FRAMEPOOL_H_INCLUDED
+#define FRAMEPOOL_H_INCLUDED
+
+#include <map>
+#include <list>
+#include <utility>
+#include <cstddef>
+#include "../algif5/algif.h"
+
+/**
+ * @brief Bitmaps of GIF frames that are expanded from their 8-bit data when they are drawn.
+ * @details Used by GIFCenter when only the indexed frames are kept. The bitmaps of the frames drawn most recently are kept up to a byte capacity, and the least recently drawn one is recycled for the next frame of the same size, or destroyed.
+ * @details Only used on the main thread.
+ */
+class FramePool
+{
+public:
+	FramePool(size_t capacity) : capacity{capacity} {}
+	~FramePool();
+	ALLEGRO_BITMAP *get(const ALGIF_ANIMATION *gif, int frame);
+	void erase(const ALGIF_ANIMATION *gif);
+	size_t size() const { return lru.size(); }
+private:
+	typedef std::pair<const ALGIF_ANIMATION*, int> Key;
+	struct Entry {
+		Key key;
+		ALLEGRO_BITMAP *bitmap;
+		size_t bytes;
+	};
+	void pop_back();
+private:
+	/**
+	 * @brief Expanded frames from the most to the least recently drawn, and their position by (animation, frame).
+	 */
+	std::list<Entry> lru;
+	std::map<Key, std::list<Entry>::iterator> index;
+	size_t capacity;
+	size_t used = 0;
+};
+
+#endif
@@ -0,0 +1,172 @@
+#include "GIFCache.h"
+#include <allegro5/allegro.h>
+#include <cstdio>
+#include <cstring>
+#include "../Utils.h"
+#include "GIFRecord.h"
+
+/*
+ * Cache file layout: CacheHeader, then the GIFRecord of the GIF. The file is
+ * named after the hash of the GIF file, and the header repeats the hash and
+ * the size so that a collision or a stale file is detected.
+ */
+namespace {
+	constexpr char cache_magic[8] = {'G', 'I', 'F', 'C', 'A', 'C', 'H', 'E'};
+	constexpr uint32_t cache_version = 1;
+
+	struct CacheHeader {
+		char magic[8];
+		uint32_t version;
+		uint32_t reserved;
+		uint64_t source_hash;
+		uint64_t source_size;
+	};
+
+	/**
+	 * @brief 64-bit FNV-1a.
+	 */
+	uint64_t hash_bytes(const std::vector<uint8_t> &data) {
+		uint64_t h = 0xcbf29ce484222325ull;
+		for(uint8_t c : data) {
+			h ^= c;
+			h *= 0x100000001b3ull;
+		}
+		return h;
+	}
+
+	bool read_file(const char *path, std::vector<uint8_t> &data) {
+		ALLEGRO_FILE *file = al_fopen(path, "rb");
+		if(!file) return false;
+		int64_t hint = al_fsize(file);
+		data.resize(hint > 0 ? static_cast<size_t>(hint) + 1 : 4096);
+		size_t size = 0;
+		while(true) {
+			size += al_fread(file, data.data() + size, data.size() - size);
+			if(size < data.size()) break;
+			data.resize(data.size() * 2);
+		}
+		bool ok = !al_ferror(file);
+		al_fclose(file);
+		data.resize(size);
+		return ok;
+	}
+
+	std::string cache_path(uint64_t hash) {
+		char name[32];
+		snprintf(name, sizeof(name), "/%016llx.gifc", static_cast<unsigned long long>(hash));
+		return GIFCacheSetting::dir + std::string(name);
+	}
+};
+
+GIFCache::~GIFCache() {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	cv.notify_all();
+	if(thread.joinable()) thread.join();
+}
+
+/**
+ * @brief Parse a GIF, from its cache file if the GIF has not changed since it was cached. Safe to call from any thread.
+ * @details On a miss the GIF is parsed from its file and its cache file is queued for writing.
+ * @details The frames are not composed and the timeline is not computed, as with algif_load_raw.
+ * @param hit if not nullptr, receives whether the GIF was read from its cache file.
+ * @return The animation, or nullptr if the GIF cannot be read.
+ */
+ALGIF_ANIMATION*
+GIFCache::load(const std::string &path, bool *hit) {
+	if(hit) *hit = false;
+	std::vector<uint8_t> source;
+	if(!read_file(path.c_str(), source)) return nullptr;
+	uint64_t hash = hash_bytes(source);
+	std::string file = cache_path(hash);
+
+	std::vector<uint8_t> cached;
+	if(read_file(file.c_str(), cached) && cached.size() >= sizeof(CacheHeader)) {
+		const CacheHeader *header = reinterpret_cast<const CacheHeader*>(cached.data());
+		if(memcmp(header->magic, cache_magic, sizeof(cache_magic)) == 0 && header->version == cache_version &&
+			header->source_hash == hash && header->source_size == source.size()) {
+			ALGIF_ANIMATION *gif = GIFRecord::read(cached.data() + sizeof(CacheHeader), cached.size() - sizeof(CacheHeader), false);
+			if(gif) {
+				if(hit) *hit = true;
+				return gif;
+			}
+		}
+		debug_log("<GIFCache> %s is stale, rewriting it.\n", file.c_str());
+	}
+
+	ALGIF_ANIMATION *gif = algif_load_raw_memory(source.data(), source.size());
+	if(!gif) return nullptr;
+	CacheHeader header{};
+	memcpy(header.magic, cache_magic, sizeof(header.magic));
+	header.version = cache_version;
+	header.source_hash = hash;
+	header.source_size = source.size();
+	std::vector<uint8_t> data(reinterpret_cast<const uint8_t*>(&header), reinterpret_cast<const uint8_t*>(&header + 1));
+	GIFRecord::write(data, gif);
+	store(std::move(file), std::move(data));
+	return gif;
+}
+
+/**
+ * @brief Delete every cache file, so that every GIF is decoded from its file again. Used to measure a cold start.
+ */
+void
+GIFCache::clear() {
+	ALLEGRO_FS_ENTRY *dir = al_create_fs_entry(GIFCacheSetting::dir);
+	if(dir && al_open_directory(dir)) {
+		while(ALLEGRO_FS_ENTRY *entry = al_read_directory(dir)) {
+			al_remove_fs_entry(entry);
+			al_destroy_fs_entry(entry);
+		}
+		al_close_directory(dir);
+	}
+	if(dir) al_destroy_fs_entry(dir);
+}
+
+void
+GIFCache::store(std::string path, std::vector<uint8_t> data) {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		if(stopping) return;
+		if(!thread.joinable()) thread = std::thread(&GIFCache::writer, this);
+		queue.push_back(Entry{std::move(path), std::move(data)});
+	}
+	cv.notify_one();
+}
+
+/**
+ * @brief Writer loop. Every file is written under a temporary name and then renamed, so a reader never sees a partial file.
+ * @details The queue is drained before the thread exits.
+ */
+void
+GIFCache::writer() {
+	bool dir_ready = al_make_directory(GIFCacheSetting::dir);
+	if(!dir_ready) debug_log("<GIFCache> cannot create %s, GIFs are not cached.\n", GIFCacheSetting::dir);
+	std::unique_lock<std::mutex> lock(mutex);
+	while(true) {
+		cv.wait(lock, [this] { return stopping || !queue.empty(); });
+		if(queue.empty()) return;
+		Entry entry = std::move(queue.front());
+		queue.pop_front();
+		lock.unlock();
+
+		if(dir_ready) {
+			std::string tmp = entry.path + ".tmp";
+			ALLEGRO_FILE *file = al_fopen(tmp.c_str(), "wb");
+			bool ok = file && al_fwrite(file, entry.data.data(), entry.data.size()) == entry.data.size();
+			if(file) ok &= al_fclose(file);
+			if(ok && rename(tmp.c_str(), entry.path.c_str()) != 0) {
+				// Windows does not replace an existing file.
+				remove(entry.path.c_str());
+				ok = rename(tmp.c_str(), entry.path.c_str()) == 0;
+			}
+			if(!ok) {
+				remove(tmp.c_str());
+				debug_log("<GIFCache> cannot write %s.\n", entry.path.c_str());
+			}
+		}
+		lock.lock();
+	}
+}
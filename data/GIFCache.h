@@ -0,0 +1,55 @@
+#ifndef GIFCACHE_H_INCLUDED
+#define GIFCACHE_H_INCLUDED
+
+#include <deque>
+#include <vector>
+#include <string>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <cstdint>
+#include "../algif5/algif.h"
+
+// fixed settings
+namespace GIFCacheSetting {
+	constexpr char dir[] = "./cache/gif";
+};
+
+/**
+ * @brief On-disk cache of decoded GIFs, keyed by the hash of the GIF file content.
+ * @details A GIF is stored as a GIFRecord, so a hit skips the LZW decoding. Editing one GIF only misses the cache for that GIF, and a reverted edit hits again.
+ * @details Cache files are written by a background thread. They can be deleted at any time.
+ */
+class GIFCache
+{
+public:
+	static GIFCache *get_instance() {
+		static GIFCache GC;
+		return &GC;
+	}
+	~GIFCache();
+	ALGIF_ANIMATION *load(const std::string &path, bool *hit = nullptr);
+	void clear();
+private:
+	GIFCache() {}
+	/**
+	 * @brief A cache file waiting to be written.
+	 */
+	struct Entry {
+		std::string path;
+		std::vector<uint8_t> data;
+	};
+	void store(std::string path, std::vector<uint8_t> data);
+	void writer();
+private:
+	/**
+	 * @brief Writer state, guarded by mutex. The writer thread starts with the first miss.
+	 */
+	std::thread thread;
+	std::mutex mutex;
+	std::condition_variable cv;
+	std::deque<Entry> queue;
+	bool stopping = false;
+};
+
+#endif
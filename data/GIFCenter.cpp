@@ -1,30 +1,206 @@
 #include "GIFCenter.h"
+#include <allegro5/allegro.h>
 #include <allegro5/bitmap_io.h>
+#include <cstdlib>
+#include <cstring>
 #include "../Utils.h"
+#include "../Benchmark.h"
+#include "DataCenter.h"
+#include "SpritePack.h"
+#include "GIFCache.h"
+#include "AtlasCenter.h"
+#include "MemoryCenter.h"
+
+/**
+ * @brief 64-bit FNV-1a of a composed frame, taken over its size and its pixels one 32-bit word at a time.
+ */
+static uint64_t hash_frame(const uint32_t *pixels, int w, int h) {
+	uint64_t hash = 0xcbf29ce484222325ull;
+	auto mix = [&hash](uint32_t word) {
+		hash ^= word;
+		hash *= 0x100000001b3ull;
+	};
+	mix(w);
+	mix(h);
+	for(size_t i = 0, n = static_cast<size_t>(w) * h; i < n; ++i) mix(pixels[i]);
+	return hash;
+}
+
+/**
+ * @brief Decode a GIF from the sprite pack if it is there and its file has not changed since, otherwise through the GIF cache. Safe to call from any thread.
+ * @param lod level of detail of the frame bitmaps, see DataCenter::lod. Composed frames are downscaled to it here.
+ * @param compose whether the frames are composed now. Otherwise only the timeline is computed, and the 8-bit frames are kept unless in headless mode, where only the metadata is kept.
+ * @param pixels receives the composed frames for algif_upload_animation, or nullptr.
+ * @param hashes receives the hash of every composed frame, so that identical frames are uploaded once.
+ */
+static ALGIF_ANIMATION *decode(const std::string &path, bool headless, int lod, bool compose, uint32_t **pixels, std::vector<uint64_t> &hashes) {
+	double start = StartupProfile::now();
+	*pixels = nullptr;
+	hashes.clear();
+	// The source that served the GIF is the kind of its load in the startup profile.
+	const char *source = "gif pack";
+	ALGIF_ANIMATION *gif = SpritePack::get_instance()->load_gif(path);
+	if(!gif) {
+		bool hit = false;
+		gif = GIFCache::get_instance()->load(path, &hit);
+		source = hit ? "gif cache" : "gif decode";
+	}
+	if(!gif) return nullptr;
+	gif->lod = lod;
+	if(headless || !compose) {
+		algif_compute_timeline(gif);
+		if(headless) algif_release_frame_data(gif);
+	} else if(algif_compose_animation(gif, pixels)) {
+		algif_downscale(*pixels, gif->width, gif->height, gif->frames_count, lod);
+		int w = algif_frame_width(gif), h = algif_frame_height(gif);
+		size_t canvas_size = static_cast<size_t>(w) * h;
+		for(int i = 0; i < gif->frames_count; ++i)
+			hashes.push_back(hash_frame(*pixels + i * canvas_size, w, h));
+	}
+	StartupProfile::get_instance()->record(source, path, StartupProfile::now() - start);
+	return gif;
+}
+
+/**
+ * @brief Memory held by a GIF: the given number of frame bitmaps, and the 8-bit frame data that is not borrowed from the sprite pack.
+ */
+static size_t gif_bytes(const ALGIF_ANIMATION *gif, int frames) {
+	size_t bytes = sizeof(uint32_t) * algif_frame_width(gif) * algif_frame_height(gif) * frames;
+	for(int i = 0; i < gif->frames_count; ++i) {
+		const ALGIF_BITMAP *data = gif->frames[i].bitmap_8_bit;
+		if(data && !data->borrowed) bytes += data->w * data->h;
+	}
+	return bytes;
+}
+
+/**
+ * @brief Name of a shared frame bitmap in MemoryCenter.
+ */
+static std::string frame_name(uint64_t hash) {
+	char name[32];
+	snprintf(name, sizeof(name), "frame %016llx", static_cast<unsigned long long>(hash));
+	return name;
+}
+
+static ALLEGRO_BITMAP *expand_frame(ALGIF_ANIMATION *gif, int frame, void *user) {
+	return static_cast<FramePool*>(user)->get(gif, frame);
+}
+
+static ALLEGRO_BITMAP *render_frame(ALGIF_ANIMATION *gif, int frame, void *user) {
+	return static_cast<GIFCenter*>(user)->render_lazily(gif, frame);
+}
+
+/**
+ * @brief The workers use the sprite pack and the GIF cache, so both are created first and destroyed after the workers are joined.
+ */
+GIFCenter::GIFCenter() : expanded{GIFSetting::expanded_frame_bytes} {
+	SpritePack::get_instance();
+	GIFCache::get_instance();
+}
 
 GIFCenter::~GIFCenter() {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+		queue.clear();
+	}
+	work_cv.notify_all();
+	for(std::thread &t : workers) t.join();
+	for(Decoded &decoded : ready) {
+		if(decoded.gif) algif_destroy_animation(decoded.gif);
+		free(decoded.pixels);
+	}
 	for(auto &[path, gif] : gifs) {
+		for(int i = 0; i < gif->frames_count; ++i) {
+			if(frame_keys.count(gif->frames[i].rendered)) gif->frames[i].rendered = nullptr;
+		}
 		algif_destroy_animation(gif);
 	}
+	for(auto &[hash, frame] : shared_frames) {
+		al_destroy_bitmap(frame.bitmap);
+	}
+	if(placeholder) algif_destroy_animation(placeholder);
+	if(storage != GIFStorage::RENDERED) algif_set_frame_expander(nullptr, nullptr);
 }
 
 /**
  * @brief The getter function searches if a bitmap is loaded and return the bitmap. If not loaded, it will try to load the GIF and return.
+ * @details GIFs in the sprite pack are composed from it instead of being decoded. Other GIFs go through GIFCache, so only GIFs that changed since the last run are decoded.
+ * @details If the GIF is being preloaded, the getter waits for its worker instead of decoding it again. Other preloaded GIFs that finish meanwhile are uploaded too.
  * @details If the respective GIF does not exist, it will immediately call GAME_ASSERT and terminate the game. This exception can be handled in various ways. e.g. load a "missing texture" when an GIF fails to load.
+ * @details In headless mode only the metadata of the GIF is loaded, and no frame bitmap is rendered.
+ * @details If getting is non-blocking, a GIF that is not loaded is preloaded instead, and a placeholder is returned until it is uploaded by poll().
+ * @details The GIF may be evicted by MemoryCenter later. Pin the path there to keep the returned pointer beyond the current update.
  * @param path the GIF path.
  * @return The curresponding loaded ALGIF_ANIMATION* instance.
  */
 ALGIF_ANIMATION*
 GIFCenter::get(const std::string &path) {
 	std::map<std::string, ALGIF_ANIMATION*>::iterator it = gifs.find(path);
-	if(it == gifs.end()) {
-		ALGIF_ANIMATION *gif = algif_load_animation(path.c_str());
-		GAME_ASSERT(gif != nullptr, "cannot find GIF: %s.", path.c_str());
-		gifs[path] = gif;
-		return gif;
-	} else {
+	if(it != gifs.end()) {
+		MemoryCenter::get_instance()->touch(AssetKind::GIF, path);
 		return it->second;
 	}
+	if(!blocking) {
+		bool queued;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			queued = pending.count(path) > 0;
+		}
+		if(!queued) {
+			debug_log("<GIFCenter> %s is not preloaded, use a placeholder meanwhile.\n", path.c_str());
+			preload({path});
+		}
+		return get_placeholder();
+	}
+	if(!workers.empty()) {
+		std::unique_lock<std::mutex> lock(mutex);
+		while(pending.count(path)) {
+			if(!upload_ready(lock)) ready_cv.wait(lock);
+		}
+		lock.unlock();
+		it = gifs.find(path);
+		if(it != gifs.end()) return it->second;
+	}
+	Decoded decoded = decode_request(make_request(path));
+	GAME_ASSERT(decoded.gif != nullptr, "cannot find GIF: %s.", path.c_str());
+	upload(decoded);
+	return decoded.gif;
+}
+
+/**
+ * @brief Size of a GIF in window coordinates, without waiting for it to be loaded.
+ * @details A GIF that is not loaded yet has its size read from the sprite pack or from the logical screen descriptor of its file, which are the first 10 bytes. Nothing is decoded.
+ * @details If the respective GIF does not exist, it will immediately call GAME_ASSERT and terminate the game.
+ * @return The width and the height.
+ */
+std::pair<int, int>
+GIFCenter::get_size(const std::string &path) {
+	std::map<std::string, ALGIF_ANIMATION*>::iterator it = gifs.find(path);
+	if(it != gifs.end()) return {it->second->width, it->second->height};
+	std::map<std::string, std::pair<int, int>>::iterator size = sizes.find(path);
+	if(size != sizes.end()) return size->second;
+	std::pair<int, int> result{0, 0};
+	if(ALGIF_ANIMATION *gif = SpritePack::get_instance()->load_gif(path)) {
+		result = {gif->width, gif->height};
+		algif_destroy_animation(gif);
+	} else if(ALLEGRO_FILE *f = al_fopen(path.c_str(), "rb")) {
+		unsigned char header[10];
+		if(al_fread(f, header, sizeof(header)) == sizeof(header) && memcmp(header, "GIF", 3) == 0)
+			result = {header[6] | header[7] << 8, header[8] | header[9] << 8};
+		al_fclose(f);
+	}
+	GAME_ASSERT(result.first > 0 && result.second > 0, "cannot find GIF: %s.", path.c_str());
+	sizes.emplace(path, result);
+	return result;
+}
+
+/**
+ * @brief Replace a placeholder returned by a non-blocking get() with the GIF, once it is loaded. Called when a kept animation is drawn.
+ */
+void
+GIFCenter::resolve(ALGIF_ANIMATION *&gif, const std::string &path) {
+	if(gif == placeholder) gif = get(path);
 }
 
 /**
@@ -39,7 +215,315 @@ GIFCenter::erase(const std::string &path) {
 		return false;
 	}
 	ALGIF_ANIMATION *bitmap = it->second;
+	expanded.erase(bitmap);
+	release_frames(bitmap);
 	algif_destroy_animation(bitmap);
 	gifs.erase(it);
+	paths.erase(bitmap);
+	MemoryCenter::get_instance()->remove(AssetKind::GIF, path);
 	return true;
 }
+
+/**
+ * @brief Choose how the frames of GIFs are stored. Must be called before any GIF is loaded.
+ * @see GIFStorage
+ */
+void
+GIFCenter::set_storage(GIFStorage storage) {
+	this->storage = storage;
+	switch(storage) {
+		case GIFStorage::RENDERED: {
+			algif_set_frame_expander(nullptr, nullptr);
+			break;
+		} case GIFStorage::LAZY: {
+			algif_set_frame_expander(render_frame, this);
+			break;
+		} case GIFStorage::INDEXED: {
+			algif_set_frame_expander(expand_frame, &expanded);
+			break;
+		}
+	}
+}
+
+/**
+ * @brief Render a frame of a loaded GIF the first time it is drawn, in lazy mode. The bitmap is kept until the GIF is erased.
+ * @details Frames are composed one by one, so playing a GIF in order composes one frame per new frame shown. Once every frame is rendered, the 8-bit frames are released.
+ * @return The bitmap of the frame, or nullptr if it cannot be created.
+ */
+ALLEGRO_BITMAP*
+GIFCenter::render_lazily(ALGIF_ANIMATION *gif, int frame) {
+	// Rendering writes to a bitmap, which is not allowed while drawing is held.
+	bool held = al_is_bitmap_drawing_held();
+	if(held) al_hold_bitmap_drawing(false);
+	int w = algif_frame_width(gif), h = algif_frame_height(gif);
+	ALLEGRO_BITMAP *bitmap = AtlasCenter::get_instance()->allocate(w, h);
+	if(!bitmap) bitmap = al_create_bitmap(w, h);
+	if(bitmap) {
+		if(!algif_expand_frame(gif, frame, bitmap))
+			debug_log("<GIFCenter> cannot render a frame of %dx%d.\n", w, h);
+		gif->frames[frame].rendered = bitmap;
+		int rendered = 0;
+		for(int i = 0; i < gif->frames_count; ++i) rendered += gif->frames[i].rendered != nullptr;
+		std::map<const ALGIF_ANIMATION*, std::string>::iterator it = paths.find(gif);
+		if(rendered == gif->frames_count) algif_release_frame_data(gif);
+		if(it != paths.end()) MemoryCenter::get_instance()->add(AssetKind::GIF, it->second, gif_bytes(gif, rendered));
+	}
+	if(held) al_hold_bitmap_drawing(true);
+	return bitmap;
+}
+
+/**
+ * @brief Start decoding GIFs in the background. Paths that are already loaded or queued are skipped.
+ * @details Returns immediately. The GIFs become available through get(), which waits for a GIF that is still being decoded, or through poll().
+ * @details Decoding (LZW, deinterlacing and palette expansion) runs on one worker per hardware thread. The frame bitmaps are uploaded on the main thread, since they belong to the display.
+ * @param paths the GIF paths.
+ */
+void
+GIFCenter::preload(const std::vector<std::string> &paths) {
+	if(workers.empty()) start_workers();
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		for(const std::string &path : paths) {
+			if(gifs.count(path) || pending.count(path)) continue;
+			pending.insert(path);
+			queue.push_back(make_request(path));
+		}
+	}
+	work_cv.notify_all();
+}
+
+/**
+ * @brief Upload the GIFs that have been decoded by the workers so far.
+ * @details Should be called regularly on the main thread while a preload is running, so that the workers are not held by GIFSetting::max_pending_bytes.
+ * @param budget time in seconds after which no further GIF is uploaded. At least one decoded GIF is uploaded per call.
+ * @return True if no GIF is waiting to be preloaded any more.
+ */
+bool
+GIFCenter::poll(double budget) {
+	if(workers.empty()) return true;
+	std::unique_lock<std::mutex> lock(mutex);
+	upload_ready(lock, al_get_time() + budget);
+	return pending.empty();
+}
+
+void
+GIFCenter::start_workers() {
+	unsigned int n = std::thread::hardware_concurrency();
+	if(n == 0) n = 1;
+	debug_log("<GIFCenter> start %u decoding workers.\n", n);
+	for(unsigned int i = 0; i < n; ++i)
+		workers.emplace_back(&GIFCenter::worker, this);
+}
+
+/**
+ * @brief Take the settings a GIF is decoded with: the headless mode, the level of detail and the storage mode. Main thread only.
+ */
+GIFCenter::Request
+GIFCenter::make_request(const std::string &path) const {
+	DataCenter *DC = DataCenter::get_instance();
+	return Request{path, DC->headless, DC->lod, storage == GIFStorage::RENDERED};
+}
+
+/**
+ * @brief Decode a GIF with the settings of its request. Reads no state of GIFCenter, so it is safe to call from any thread.
+ */
+GIFCenter::Decoded
+GIFCenter::decode_request(const Request &request) {
+	Decoded decoded{request.path, request.compose, nullptr, nullptr, 0, {}};
+	decoded.gif = decode(request.path, request.headless, request.lod, request.compose, &decoded.pixels, decoded.hashes);
+	if(decoded.pixels)
+		decoded.bytes = sizeof(uint32_t) * algif_frame_width(decoded.gif) * algif_frame_height(decoded.gif) * decoded.gif->frames_count;
+	return decoded;
+}
+
+/**
+ * @brief Worker loop: take a request from the queue, decode it without the lock, and hand the result to the main thread.
+ */
+void
+GIFCenter::worker() {
+	SpritePack::get_instance()->use_file_interface();
+	std::unique_lock<std::mutex> lock(mutex);
+	while(true) {
+		work_cv.wait(lock, [this] {
+			return stopping || (!queue.empty() && (ready.empty() || ready_bytes < GIFSetting::max_pending_bytes));
+		});
+		if(stopping) return;
+		Request request = std::move(queue.front());
+		queue.pop_front();
+		lock.unlock();
+
+		Decoded decoded = decode_request(request);
+
+		lock.lock();
+		ready_bytes += decoded.bytes;
+		ready.emplace_back(std::move(decoded));
+		ready_cv.notify_all();
+	}
+}
+
+void
+GIFCenter::upload(Decoded &decoded) {
+	if(!decoded.gif) {
+		// Leave it to get(), which reports the missing GIF.
+		debug_log("<GIFCenter> preload failed: %s.\n", decoded.path.c_str());
+		return;
+	}
+	double start = StartupProfile::now();
+	ALGIF_ANIMATION *gif = decoded.gif;
+	int own_frames = 0;
+	// Uploaded the way it was decoded, even if the storage mode changed since it was queued.
+	if(!DataCenter::get_instance()->headless && decoded.compose)
+		own_frames = upload_frames(gif, decoded.pixels, decoded.hashes);
+	decoded.pixels = nullptr;
+	gifs[decoded.path] = gif;
+	paths[gif] = decoded.path;
+	// Shared frames are accounted on their own by upload_frames().
+	MemoryCenter::get_instance()->add(AssetKind::GIF, decoded.path, gif_bytes(gif, own_frames));
+	StartupProfile::get_instance()->record("gif upload", decoded.path, StartupProfile::now() - start);
+}
+
+/**
+ * @brief Whether a bitmap holds exactly the given w x h pixels in ALLEGRO_PIXEL_FORMAT_ABGR_8888. Reads the bitmap back.
+ */
+static bool same_pixels(ALLEGRO_BITMAP *bitmap, const uint32_t *pixels, int w, int h) {
+	if(al_get_bitmap_width(bitmap) != w || al_get_bitmap_height(bitmap) != h) return false;
+	ALLEGRO_LOCKED_REGION *lr = al_lock_bitmap(bitmap, ALLEGRO_PIXEL_FORMAT_ABGR_8888, ALLEGRO_LOCK_READONLY);
+	if(!lr) return false;
+	bool same = true;
+	size_t row = sizeof(uint32_t) * w;
+	for(int y = 0; y < h && same; ++y)
+		same = memcmp(static_cast<const uint8_t*>(lr->data) + static_cast<ptrdiff_t>(y) * lr->pitch, pixels + static_cast<size_t>(y) * w, row) == 0;
+	al_unlock_bitmap(bitmap);
+	return same;
+}
+
+/**
+ * @brief Upload the frames of a GIF, sharing the bitmap of every frame that is identical to a frame uploaded before, in this GIF or in another one.
+ * @details Frames are found by their hash, then compared pixel by pixel, so a hash collision never shows the frame of another GIF: the colliding frame gets a bitmap of its own. Many GIFs repeat poses of one another, e.g. the eating and walking animations of a zombie.
+ * @details Every shared frame bitmap is accounted in MemoryCenter under its own AssetKind::FRAME entry, from its upload until release_frames() drops its last reference, so its memory is counted once whichever GIFs use it.
+ * @param pixels the composed frames, which are freed.
+ * @param hashes the hash of every frame, or empty if the frames could not be composed. Nothing is shared then.
+ * @return Number of frame bitmaps owned by the GIF alone, which are accounted with it.
+ */
+int
+GIFCenter::upload_frames(ALGIF_ANIMATION *gif, uint32_t *pixels, const std::vector<uint64_t> &hashes) {
+	if(hashes.empty()) {
+		algif_upload_animation(gif, pixels);
+		return gif->frames_count;
+	}
+	int w = algif_frame_width(gif), h = algif_frame_height(gif);
+	size_t canvas_size = static_cast<size_t>(w) * h;
+	auto frame = [pixels, canvas_size](int i) { return pixels + i * canvas_size; };
+	// source[i] is the first frame of this GIF identical to frame i.
+	std::vector<int> source(gif->frames_count);
+	// Frames whose hash is taken by different pixels. They are neither shared nor registered.
+	std::vector<bool> collided(gif->frames_count);
+	std::map<uint64_t, int> first;
+	for(int i = 0; i < gif->frames_count; ++i) {
+		source[i] = i;
+		std::map<uint64_t, SharedFrame>::iterator it = shared_frames.find(hashes[i]);
+		if(it != shared_frames.end()) {
+			if(same_pixels(it->second.bitmap, frame(i), w, h)) {
+				gif->frames[i].rendered = it->second.bitmap;
+				++it->second.refs;
+			} else collided[i] = true;
+			continue;
+		}
+		auto [f, inserted] = first.emplace(hashes[i], i);
+		if(inserted || memcmp(frame(f->second), frame(i), sizeof(uint32_t) * canvas_size) == 0) source[i] = f->second;
+		else collided[i] = true;
+	}
+	std::vector<bool> shared(gif->frames_count);
+	for(int i = 0; i < gif->frames_count; ++i) shared[i] = gif->frames[i].rendered != nullptr;
+	algif_upload_frames(gif, pixels, source.data());
+	size_t frame_bytes = sizeof(uint32_t) * canvas_size;
+	int own = 0;
+	for(int i = 0; i < gif->frames_count; ++i) {
+		ALLEGRO_BITMAP *bitmap = gif->frames[i].rendered;
+		if(shared[i] || !bitmap) continue;
+		if(collided[i]) {
+			debug_log("<GIFCenter> frame %d collides with a different frame of the same hash, not shared.\n", i);
+			++own;
+			continue;
+		}
+		if(source[i] < i) {
+			++shared_frames.at(hashes[i]).refs;
+			continue;
+		}
+		shared_frames[hashes[i]] = SharedFrame{bitmap, 1};
+		frame_keys[bitmap] = hashes[i];
+		MemoryCenter::get_instance()->add(AssetKind::FRAME, frame_name(hashes[i]), frame_bytes);
+	}
+	return own;
+}
+
+/**
+ * @brief Drop the references of a GIF to its frame bitmaps. A bitmap is released once no GIF uses it.
+ * @details The frames may be in the atlas, whose pages are freed once all their frames are released.
+ */
+void
+GIFCenter::release_frames(ALGIF_ANIMATION *gif) {
+	AtlasCenter *AC = AtlasCenter::get_instance();
+	for(int i = 0; i < gif->frames_count; ++i) {
+		ALLEGRO_BITMAP *bitmap = gif->frames[i].rendered;
+		gif->frames[i].rendered = nullptr;
+		std::map<ALLEGRO_BITMAP*, uint64_t>::iterator key = frame_keys.find(bitmap);
+		if(key == frame_keys.end()) {
+			AC->release(bitmap);
+			continue;
+		}
+		std::map<uint64_t, SharedFrame>::iterator it = shared_frames.find(key->second);
+		if(--it->second.refs > 0) continue;
+		AC->release(bitmap);
+		MemoryCenter::get_instance()->remove(AssetKind::FRAME, frame_name(key->second));
+		shared_frames.erase(it);
+		frame_keys.erase(key);
+	}
+}
+
+/**
+ * @brief Upload the decoded GIFs until the deadline. The lock is released during the uploads.
+ * @details The GIFs that are not uploaded before the deadline stay in ready for the next call.
+ * @return True if any GIF has been uploaded.
+ */
+bool
+GIFCenter::upload_ready(std::unique_lock<std::mutex> &lock, double deadline) {
+	if(ready.empty()) return false;
+	std::vector<Decoded> batch;
+	batch.swap(ready);
+	ready_bytes = 0;
+	lock.unlock();
+	work_cv.notify_all();
+	size_t n = 0;
+	do {
+		upload(batch[n++]);
+	} while(n < batch.size() && al_get_time() < deadline);
+	lock.lock();
+	for(size_t i = 0; i < n; ++i) pending.erase(batch[i].path);
+	for(size_t i = n; i < batch.size(); ++i) {
+		ready_bytes += batch[i].bytes;
+		ready.emplace_back(std::move(batch[i]));
+	}
+	return true;
+}
+
+/**
+ * @brief A transparent 1x1 animation, returned by get() while a GIF is not loaded.
+ */
+ALGIF_ANIMATION*
+GIFCenter::get_placeholder() {
+	if(placeholder) return placeholder;
+	placeholder = static_cast<ALGIF_ANIMATION*>(calloc(1, sizeof(ALGIF_ANIMATION)));
+	placeholder->width = placeholder->height = 1;
+	placeholder->frames = static_cast<ALGIF_FRAME*>(calloc(1, sizeof(ALGIF_FRAME)));
+	placeholder->frames_count = 1;
+	ALGIF_FRAME &frame = placeholder->frames[0];
+	frame.bitmap_8_bit = algif_create_bitmap(1, 1);
+	frame.duration = 10;
+	frame.transparent_index = 0;
+	uint32_t *pixels;
+	algif_compose_animation(placeholder, &pixels);
+	if(DataCenter::get_instance()->headless) free(pixels);
+	else algif_upload_animation(placeholder, pixels);
+	return placeholder;
+}
@@ -2,13 +2,58 @@
 #define GIFCENTER_H_INCLUDED
 
 #include <map>
+#include <set>
+#include <deque>
+#include <vector>
 #include <string>
+#include <limits>
+#include <utility>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
 #include "../algif5/algif.h"
+#include "FramePool.h"
+
+// fixed settings
+namespace GIFSetting {
+	/**
+	 * @brief Upper bound of decoded pixels waiting for upload, in bytes. Workers wait when it is reached, so preloading many GIFs does not hold all of them in memory twice.
+	 */
+	constexpr size_t max_pending_bytes = 256 << 20;
+	/**
+	 * @brief Capacity of the bitmaps of expanded frames in GIFStorage::INDEXED mode, in bytes.
+	 */
+	constexpr size_t expanded_frame_bytes = 32 << 20;
+};
+
+/**
+ * @brief How the frames of GIFs are stored.
+ */
+enum class GIFStorage {
+	/**
+	 * @brief Every frame is rendered into a bitmap when the GIF is loaded.
+	 */
+	RENDERED,
+	/**
+	 * @brief A frame is rendered into a bitmap the first time it is drawn, and kept. Frames that are never shown cost nothing but their 8-bit data.
+	 */
+	LAZY,
+	/**
+	 * @brief Only the 8-bit frames are kept. The frames on screen are expanded into a FramePool of bounded size when they are drawn.
+	 */
+	INDEXED
+};
 
 /**
  * @brief Stores and manages bitmaps.
  * @details GIFCenter loads bitmap data dynamically and persistently. That is, an GIF will only be loaded when demanded by getter function, and will be stored inside memory once loaded.
- * This center does not free any bitmap as long as the game is running. You can manually free bitmaps that will not be used again if you want to reduce the memory usage.
+ * GIFs are freed by MemoryCenter when the memory budget is exceeded, least recently used first, and loaded again when they are demanded next time.
+ * @details Identical frames, within a GIF or across GIFs, share one bitmap.
+ * @details Frames can also be rendered only when they are first drawn, see set_storage().
+ * @details Frame bitmaps are downscaled to the level of detail of DataCenter::lod, and are drawn with LOD::draw(). The size of a GIF stays the size of its source.
+ * @details GIFs can also be preloaded. They are then decoded on a pool of worker threads, and only the upload of the frame bitmaps runs on the main thread.
+ * @details While a level is played, getting is non-blocking (see set_blocking()): a GIF that is not loaded yet is preloaded and a transparent placeholder is returned meanwhile.
+ * The placeholder has no meaningful size: gameplay sizes come from get_size(), and a kept pointer is swapped for the GIF with resolve() when it is drawn.
  */
 class GIFCenter
 {
@@ -21,13 +66,97 @@ public:
 	ALGIF_ANIMATION *get(const std::string &path);
 	ALGIF_ANIMATION *get(const char *path) { return get(std::string{path}); }
 	bool erase(const std::string &path);
+	bool is_loaded(const std::string &path) const { return gifs.count(path) > 0; }
+	std::pair<int, int> get_size(const std::string &path);
+	void resolve(ALGIF_ANIMATION *&gif, const std::string &path);
+	void preload(const std::vector<std::string> &paths);
+	bool poll(double budget = std::numeric_limits<double>::infinity());
+	void set_blocking(bool blocking) { this->blocking = blocking; }
+	void set_storage(GIFStorage storage);
+	ALLEGRO_BITMAP *render_lazily(ALGIF_ANIMATION *gif, int frame);
+private:
+	GIFCenter();
+	/**
+	 * @brief A GIF to be decoded, with the settings it is decoded with. They are taken on the main thread when the GIF is queued, so the workers never read the settings themselves.
+	 */
+	struct Request {
+		std::string path;
+		bool headless;
+		int lod;
+		/**
+		 * @brief Whether the frames are composed for GIFStorage::RENDERED.
+		 */
+		bool compose;
+	};
+	/**
+	 * @brief A GIF decoded by a worker, waiting for its frames to be uploaded.
+	 */
+	struct Decoded {
+		std::string path;
+		bool compose;
+		ALGIF_ANIMATION *gif;
+		uint32_t *pixels;
+		size_t bytes;
+		std::vector<uint64_t> hashes;
+	};
+	Request make_request(const std::string &path) const;
+	static Decoded decode_request(const Request &request);
+	/**
+	 * @brief A frame bitmap used by one or more frames of loaded GIFs.
+	 */
+	struct SharedFrame {
+		ALLEGRO_BITMAP *bitmap;
+		int refs;
+	};
+	void start_workers();
+	void worker();
+	void upload(Decoded &decoded);
+	int upload_frames(ALGIF_ANIMATION *gif, uint32_t *pixels, const std::vector<uint64_t> &hashes);
+	void release_frames(ALGIF_ANIMATION *gif);
+	bool upload_ready(std::unique_lock<std::mutex> &lock, double deadline = std::numeric_limits<double>::infinity());
+	ALGIF_ANIMATION *get_placeholder();
 private:
-	GIFCenter() {}
 	/**
 	 * @brief All loaded bitmaps are stored in this map container.
 	 * @details The key object of this map is the GIF path. Make sure the path must be the same if the same GIF will be queried multiple times, otherwise the GIF will be duplicately loaded.
 	 */
 	std::map<std::string, ALGIF_ANIMATION*> gifs;
+	/**
+	 * @brief If false, get() returns the placeholder instead of waiting for a GIF that is not loaded yet.
+	 */
+	bool blocking = true;
+	/**
+	 * @brief Frame bitmaps by the hash of their content, and the hash of every frame bitmap, so identical frames are uploaded once.
+	 */
+	std::map<uint64_t, SharedFrame> shared_frames;
+	std::map<ALLEGRO_BITMAP*, uint64_t> frame_keys;
+	GIFStorage storage = GIFStorage::RENDERED;
+	/**
+	 * @brief Frames on screen in GIFStorage::INDEXED mode.
+	 */
+	FramePool expanded;
+	/**
+	 * @brief Path of every loaded GIF, to account the frames rendered lazily.
+	 */
+	std::map<const ALGIF_ANIMATION*, std::string> paths;
+	ALGIF_ANIMATION *placeholder = nullptr;
+	/**
+	 * @brief Size of every GIF whose size was asked for before it was loaded, read from its header.
+	 */
+	std::map<std::string, std::pair<int, int>> sizes;
+	/**
+	 * @brief Preload state shared with the workers, guarded by mutex.
+	 * @details pending holds every path that is queued, being decoded or waiting in ready.
+	 */
+	std::vector<std::thread> workers;
+	std::mutex mutex;
+	std::condition_variable work_cv;
+	std::condition_variable ready_cv;
+	std::deque<Request> queue;
+	std::set<std::string> pending;
+	std::vector<Decoded> ready;
+	size_t ready_bytes = 0;
+	bool stopping = false;
 };
 
 #endif
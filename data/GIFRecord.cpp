@@ -0,0 +1,128 @@
+#include "GIFRecord.h"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+namespace {
+	struct RecordGif {
+		int32_t width, height, frames_count, background_index, loop, palette_count;
+		uint8_t palette[256 * 3];
+	};
+	struct RecordFrame {
+		int32_t xoff, yoff, width, height, duration, disposal_method, transparent_index, palette_count;
+		uint64_t pixels_offset;
+		uint8_t palette[256 * 3];
+	};
+
+	void copy_palette(uint8_t *dst, const ALGIF_PALETTE &palette) {
+		for(int i = 0; i < 256; ++i) {
+			dst[i * 3] = palette.colors[i].r;
+			dst[i * 3 + 1] = palette.colors[i].g;
+			dst[i * 3 + 2] = palette.colors[i].b;
+		}
+	}
+
+	void read_palette(ALGIF_PALETTE &palette, const uint8_t *src, int32_t colors_count) {
+		palette.colors_count = std::clamp(colors_count, 0, 256);
+		for(int i = 0; i < 256; ++i) {
+			palette.colors[i].r = src[i * 3];
+			palette.colors[i].g = src[i * 3 + 1];
+			palette.colors[i].b = src[i * 3 + 2];
+		}
+	}
+
+	void append(std::vector<uint8_t> &out, const void *data, size_t size) {
+		const uint8_t *p = static_cast<const uint8_t*>(data);
+		out.insert(out.end(), p, p + size);
+	}
+};
+
+/**
+ * @brief Append the record of a parsed GIF to out. The frames must still have their 8-bit data.
+ */
+void
+GIFRecord::write(std::vector<uint8_t> &out, const ALGIF_ANIMATION *gif) {
+	RecordGif header{};
+	header.width = gif->width;
+	header.height = gif->height;
+	header.frames_count = gif->frames_count;
+	header.background_index = gif->background_index;
+	header.loop = gif->loop;
+	header.palette_count = gif->palette.colors_count;
+	copy_palette(header.palette, gif->palette);
+	append(out, &header, sizeof(header));
+	uint64_t pixels_offset = sizeof(RecordGif) + sizeof(RecordFrame) * gif->frames_count;
+	for(int i = 0; i < gif->frames_count; ++i) {
+		const ALGIF_FRAME &f = gif->frames[i];
+		RecordFrame frame{};
+		frame.xoff = f.xoff;
+		frame.yoff = f.yoff;
+		frame.width = f.bitmap_8_bit->w;
+		frame.height = f.bitmap_8_bit->h;
+		frame.duration = f.duration;
+		frame.disposal_method = f.disposal_method;
+		frame.transparent_index = f.transparent_index;
+		frame.palette_count = f.palette.colors_count;
+		frame.pixels_offset = pixels_offset;
+		copy_palette(frame.palette, f.palette);
+		append(out, &frame, sizeof(frame));
+		pixels_offset += static_cast<uint64_t>(frame.width) * frame.height;
+	}
+	for(int i = 0; i < gif->frames_count; ++i) {
+		const ALGIF_BITMAP *bmp = gif->frames[i].bitmap_8_bit;
+		append(out, bmp->data, static_cast<size_t>(bmp->w) * bmp->h);
+	}
+}
+
+/**
+ * @brief Create an animation from a record. Safe to call from any thread.
+ * @details The timeline is not computed and no frame is composed yet.
+ * @param borrow if true, the frames point into data, which must outlive the animation. Otherwise the indices are copied.
+ * @return The animation, or nullptr if the record is malformed.
+ */
+ALGIF_ANIMATION*
+GIFRecord::read(const uint8_t *data, size_t size, bool borrow) {
+	auto in_range = [size](uint64_t offset, uint64_t length) { return offset <= size && length <= size - offset; };
+	if(size < sizeof(RecordGif)) return nullptr;
+	const RecordGif *header = reinterpret_cast<const RecordGif*>(data);
+	if(header->frames_count < 0 || !in_range(sizeof(RecordGif), sizeof(RecordFrame) * static_cast<uint64_t>(header->frames_count)))
+		return nullptr;
+	const RecordFrame *frames = reinterpret_cast<const RecordFrame*>(data + sizeof(RecordGif));
+	for(int i = 0; i < header->frames_count; ++i) {
+		const RecordFrame &f = frames[i];
+		if(f.width < 0 || f.height < 0 || !in_range(f.pixels_offset, static_cast<uint64_t>(f.width) * f.height))
+			return nullptr;
+	}
+
+	ALGIF_ANIMATION *gif = static_cast<ALGIF_ANIMATION*>(calloc(1, sizeof(ALGIF_ANIMATION)));
+	gif->width = header->width;
+	gif->height = header->height;
+	gif->background_index = header->background_index;
+	gif->loop = header->loop;
+	read_palette(gif->palette, header->palette, header->palette_count);
+	gif->frames = static_cast<ALGIF_FRAME*>(calloc(header->frames_count > 0 ? header->frames_count : 1, sizeof(ALGIF_FRAME)));
+	gif->frames_count = header->frames_count;
+	for(int i = 0; i < header->frames_count; ++i) {
+		const RecordFrame &f = frames[i];
+		ALGIF_FRAME &frame = gif->frames[i];
+		ALGIF_BITMAP *bmp;
+		if(borrow) {
+			bmp = static_cast<ALGIF_BITMAP*>(calloc(1, sizeof(ALGIF_BITMAP)));
+			bmp->w = f.width;
+			bmp->h = f.height;
+			bmp->data = const_cast<uint8_t*>(data + f.pixels_offset);
+			bmp->borrowed = true;
+		} else {
+			bmp = algif_create_bitmap(f.width, f.height);
+			memcpy(bmp->data, data + f.pixels_offset, static_cast<size_t>(f.width) * f.height);
+		}
+		frame.bitmap_8_bit = bmp;
+		frame.xoff = f.xoff;
+		frame.yoff = f.yoff;
+		frame.duration = f.duration;
+		frame.disposal_method = f.disposal_method;
+		frame.transparent_index = f.transparent_index;
+		read_palette(frame.palette, f.palette, f.palette_count);
+	}
+	return gif;
+}
@@ -0,0 +1,18 @@
+#ifndef GIFRECORD_H_INCLUDED
+#define GIFRECORD_H_INCLUDED
+
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include "../algif5/algif.h"
+
+/**
+ * @brief Binary form of a parsed GIF: header, palettes and the decoded indices of every frame.
+ * @details Used by the sprite pack and the GIF cache. Offsets inside a record are relative to its start, so a record can be read wherever it is stored, as long as the start is 16-byte aligned.
+ */
+namespace GIFRecord {
+	void write(std::vector<uint8_t> &out, const ALGIF_ANIMATION *gif);
+	ALGIF_ANIMATION *read(const uint8_t *data, size_t size, bool borrow);
+};
+
+#endif
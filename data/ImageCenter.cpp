@@ -1,16 +1,105 @@
 #include "ImageCenter.h"
+#include <allegro5/allegro.h>
 #include <allegro5/bitmap_io.h>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
 #include "../Utils.h"
+#include "../Benchmark.h"
+#include "../algif5/algif.h"
+#include "DataCenter.h"
+#include "AtlasCenter.h"
+#include "SpritePack.h"
+#include "MemoryCenter.h"
+
+/**
+ * @brief Replace a loaded bitmap with a copy downscaled by 2^lod with a box filter, see algif_downscale. The loaded bitmap is destroyed.
+ * @return The downscaled bitmap, or the loaded one if it cannot be read.
+ */
+static ALLEGRO_BITMAP *downscale(ALLEGRO_BITMAP *bitmap, int lod) {
+	int w = al_get_bitmap_width(bitmap), h = al_get_bitmap_height(bitmap);
+	ALLEGRO_LOCKED_REGION *lr = al_lock_bitmap(bitmap, ALLEGRO_PIXEL_FORMAT_ABGR_8888, ALLEGRO_LOCK_READONLY);
+	if(!lr) return bitmap;
+	std::vector<uint32_t> pixels(static_cast<size_t>(w) * h);
+	for(int y = 0; y < h; ++y)
+		memcpy(pixels.data() + static_cast<size_t>(y) * w, static_cast<const uint8_t*>(lr->data) + static_cast<ptrdiff_t>(y) * lr->pitch, sizeof(uint32_t) * w);
+	al_unlock_bitmap(bitmap);
+	algif_downscale(pixels.data(), w, h, 1, lod);
+	ALLEGRO_BITMAP *scaled = AtlasCenter::get_instance()->upload(pixels.data(), algif_lod_size(w, lod), algif_lod_size(h, lod));
+	if(!scaled) return bitmap;
+	al_destroy_bitmap(bitmap);
+	return scaled;
+}
+
+/**
+ * @brief Read the size of a PNG, JPEG or BMP image from the header of its file, without decoding it.
+ * @return False if the file cannot be opened or its format is not recognized.
+ */
+static bool read_image_size(const std::string &path, int &width, int &height) {
+	ALLEGRO_FILE *f = al_fopen(path.c_str(), "rb");
+	if(!f) return false;
+	unsigned char header[26];
+	size_t n = al_fread(f, header, sizeof(header));
+	bool found = false;
+	if(n >= 24 && memcmp(header, "\x89PNG", 4) == 0) {
+		// The IHDR chunk comes first, with the size in big endian.
+		width = header[16] << 24 | header[17] << 16 | header[18] << 8 | header[19];
+		height = header[20] << 24 | header[21] << 16 | header[22] << 8 | header[23];
+		found = true;
+	} else if(n >= 26 && header[0] == 'B' && header[1] == 'M') {
+		// BITMAPINFOHEADER. The height is negative for top-down images.
+		width = header[18] | header[19] << 8 | header[20] << 16 | header[21] << 24;
+		height = std::abs(static_cast<int32_t>(header[22] | header[23] << 8 | header[24] << 16 | static_cast<uint32_t>(header[25]) << 24));
+		found = true;
+	} else if(n >= 2 && header[0] == 0xFF && header[1] == 0xD8) {
+		// Walk the JPEG segments up to the first start of frame.
+		al_fseek(f, 2, ALLEGRO_SEEK_SET);
+		unsigned char segment[9];
+		while(al_fread(f, segment, 4) == 4 && segment[0] == 0xFF) {
+			int marker = segment[1], length = segment[2] << 8 | segment[3];
+			bool sof = marker >= 0xC0 && marker <= 0xCF && marker != 0xC4 && marker != 0xC8 && marker != 0xCC;
+			if(sof) {
+				if(al_fread(f, segment + 4, 5) == 5) {
+					height = segment[5] << 8 | segment[6];
+					width = segment[7] << 8 | segment[8];
+					found = true;
+				}
+				break;
+			}
+			if(length < 2 || !al_fseek(f, length - 2, ALLEGRO_SEEK_CUR)) break;
+		}
+	}
+	al_fclose(f);
+	return found && width > 0 && height > 0;
+}
 
 ImageCenter::~ImageCenter() {
 	for(auto &[path, bitmap] : bitmaps) {
 		al_destroy_bitmap(bitmap);
 	}
+	if(sized_parent) al_destroy_bitmap(sized_parent);
+}
+
+/**
+ * @brief Create a bitmap that has a size but no pixels: a sub-bitmap of a 1x1 memory bitmap, which may extend past its parent. Only its size may be read.
+ */
+ALLEGRO_BITMAP*
+ImageCenter::create_sized(int width, int height) {
+	if(!sized_parent) {
+		sized_parent = al_create_bitmap(1, 1);
+		GAME_ASSERT(sized_parent != nullptr, "cannot create bitmap.");
+	}
+	return al_create_sub_bitmap(sized_parent, 0, 0, width, height);
 }
 
 /**
  * @brief The getter function searches if a bitmap is loaded and return the bitmap. If not loaded, it will try to load the image and return.
  * @details If the respective image does not exist, it will immediately call GAME_ASSERT and terminate the game. This exception can be handled in various ways. e.g. load a "missing texture" when an image fails to load.
+ * @details In headless mode the image is not decoded. Its size is read from the sprite pack or from the header of its file if it is a PNG, JPEG or BMP, and the returned bitmap has that size but no pixels, see create_sized().
+ * @details Images in the sprite pack are copied from it instead of being decoded.
+ * @details Small images are moved into the texture atlas, so the returned bitmap may be a sub-bitmap.
+ * @details Images are downscaled to the level of detail of DataCenter::lod. Use LOD::width(), LOD::height() and LOD::draw() for their size on screen.
+ * @details The bitmap may be evicted by MemoryCenter later. Pin the path there to keep the returned pointer beyond the current update.
  * @param path the image path.
  * @return The curresponding loaded ALLEGRO_BITMAP* instance.
  */
@@ -18,15 +107,50 @@ ALLEGRO_BITMAP*
 ImageCenter::get(const std::string &path) {
 	std::map<std::string, ALLEGRO_BITMAP*>::iterator it = bitmaps.find(path);
 	if(it == bitmaps.end()) {
-		ALLEGRO_BITMAP *bitmap = al_load_bitmap(path.c_str());
-		GAME_ASSERT(bitmap != nullptr, "cannot find image: %s.", path.c_str());
+		double start = StartupProfile::now();
+		int lod = DataCenter::get_instance()->lod;
+		ALLEGRO_BITMAP *bitmap = nullptr;
+		if(DataCenter::get_instance()->headless) {
+			std::pair<int, int> size = get_size(path);
+			bitmap = create_sized(size.first, size.second);
+		} else bitmap = SpritePack::get_instance()->load_image(path, lod);
+		if(!bitmap) {
+			bitmap = al_load_bitmap(path.c_str());
+			GAME_ASSERT(bitmap != nullptr, "cannot find image: %s.", path.c_str());
+			if(lod > 0) bitmap = downscale(bitmap, lod);
+			else bitmap = AtlasCenter::get_instance()->pack(bitmap);
+		}
 		bitmaps[path] = bitmap;
+		StartupProfile::get_instance()->record("image", path, StartupProfile::now() - start);
+		size_t bytes = DataCenter::get_instance()->headless ? 0 : sizeof(uint32_t) * al_get_bitmap_width(bitmap) * al_get_bitmap_height(bitmap);
+		MemoryCenter::get_instance()->add(AssetKind::IMAGE, path, bytes);
 		return bitmap;
 	} else {
+		MemoryCenter::get_instance()->touch(AssetKind::IMAGE, path);
 		return it->second;
 	}
 }
 
+/**
+ * @brief Size of an image as stored in its file, whatever its level of detail. The image is not loaded.
+ * @details The size is read from the sprite pack, or from the header of the file if it is a PNG, JPEG or BMP. Other formats are decoded once for their size.
+ */
+std::pair<int, int>
+ImageCenter::get_size(const std::string &path) {
+	std::map<std::string, std::pair<int, int>>::iterator it = sizes.find(path);
+	if(it != sizes.end()) return it->second;
+	int w = 0, h = 0;
+	if(!SpritePack::get_instance()->image_size(path, w, h) && !read_image_size(path, w, h)) {
+		ALLEGRO_BITMAP *decoded = al_load_bitmap(path.c_str());
+		GAME_ASSERT(decoded != nullptr, "cannot find image: %s.", path.c_str());
+		w = al_get_bitmap_width(decoded);
+		h = al_get_bitmap_height(decoded);
+		al_destroy_bitmap(decoded);
+	}
+	sizes.emplace(path, std::pair<int, int>{w, h});
+	return {w, h};
+}
+
 /**
  * @brief Remove a bitmap.
  * @param path the image path.
@@ -39,7 +163,8 @@ ImageCenter::erase(const std::string &path) {
 		return false;
 	}
 	ALLEGRO_BITMAP *bitmap = it->second;
-	al_destroy_bitmap(bitmap);
+	AtlasCenter::get_instance()->release(bitmap);
 	bitmaps.erase(it);
+	MemoryCenter::get_instance()->remove(AssetKind::IMAGE, path);
 	return true;
 }
@@ -3,12 +3,14 @@
 
 #include <map>
 #include <string>
+#include <utility>
 #include <allegro5/bitmap.h>
 
 /**
  * @brief Stores and manages bitmaps.
  * @details ImageCenter loads bitmap data dynamically and persistently. That is, an image will only be loaded when demanded by getter function, and will be stored inside memory once loaded.
- * This center does not free any bitmap as long as the game is running. You can manually free bitmaps that will not be used again if you want to reduce the memory usage.
+ * Bitmaps are freed by MemoryCenter when the memory budget is exceeded, least recently used first, and loaded again when they are demanded next time.
+ * @details Bitmaps may be downscaled for the display, see LOD. Gameplay sizes, e.g. hit boxes, come from get_size(), so they do not depend on the display scale.
  */
 class ImageCenter
 {
@@ -21,13 +23,23 @@ public:
 	ALLEGRO_BITMAP *get(const std::string &path);
 	ALLEGRO_BITMAP *get(const char *path) { return get(std::string{path}); }
 	bool erase(const std::string &path);
+	std::pair<int, int> get_size(const std::string &path);
 private:
 	ImageCenter() {}
+	ALLEGRO_BITMAP *create_sized(int width, int height);
 	/**
 	 * @brief All loaded bitmaps are stored in this map container.
 	 * @details The key object of this map is the image path. Make sure the path must be the same if the same image will be queried multiple times, otherwise the image will be duplicately loaded.
 	 */
 	std::map<std::string, ALLEGRO_BITMAP*> bitmaps;
+	/**
+	 * @brief Size of the source file of every image whose size was asked for.
+	 */
+	std::map<std::string, std::pair<int, int>> sizes;
+	/**
+	 * @brief 1x1 parent of the bitmaps created in headless mode, which only have a size.
+	 */
+	ALLEGRO_BITMAP *sized_parent = nullptr;
 };
 
 #endif
@@ -0,0 +1,41 @@
+#include "LOD.h"
+#include <allegro5/allegro.h>
+#include "DataCenter.h"
+
+/**
+ * @brief The coarsest level whose sprites are still drawn at a scale of at most 1 on a display scaled by the given factor.
+ */
+int
+LOD::level_for_scale(double scale) {
+	int level = 0;
+	while(level < LODSetting::max_level && scale * (2 << level) <= 1) ++level;
+	return level;
+}
+
+/**
+ * @brief Width of a sprite in window coordinates.
+ * @details Downscaled sprites are rounded up to whole texels, so this may exceed the source image by up to 2^lod - 1 transparent pixels.
+ */
+int
+LOD::width(ALLEGRO_BITMAP *bitmap) {
+	return al_get_bitmap_width(bitmap) << DataCenter::get_instance()->lod;
+}
+
+int
+LOD::height(ALLEGRO_BITMAP *bitmap) {
+	return al_get_bitmap_height(bitmap) << DataCenter::get_instance()->lod;
+}
+
+/**
+ * @brief Draw a sprite at its size in window coordinates, like al_draw_bitmap().
+ */
+void
+LOD::draw(ALLEGRO_BITMAP *bitmap, float dx, float dy, int flags) {
+	int lod = DataCenter::get_instance()->lod;
+	if(lod == 0) {
+		al_draw_bitmap(bitmap, dx, dy, flags);
+		return;
+	}
+	int w = al_get_bitmap_width(bitmap), h = al_get_bitmap_height(bitmap);
+	al_draw_scaled_bitmap(bitmap, 0, 0, w, h, dx, dy, w << lod, h << lod, flags);
+}
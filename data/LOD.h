@@ -0,0 +1,26 @@
+#ifndef LOD_H_INCLUDED
+#define LOD_H_INCLUDED
+
+#include <allegro5/bitmap.h>
+
+// fixed settings
+namespace LODSetting {
+	/**
+	 * @brief Coarsest level of detail. Sprites are stored at no less than 1/2^max_level of their size.
+	 */
+	constexpr int max_level = 2;
+};
+
+/**
+ * @brief Level of detail of the sprites loaded by ImageCenter and GIFCenter.
+ * @details When the display is scaled down (see DataCenter::display_scale), sprites are box-filtered to half or a quarter of their size when they are loaded, so they take a fraction of the texture memory and fill rate. The level is the coarsest one at which a sprite still has at least one texel per pixel on screen.
+ * @details A downscaled sprite keeps its size in window coordinates: its size and drawing must go through these functions instead of al_get_bitmap_width(), al_get_bitmap_height() and al_draw_bitmap().
+ */
+namespace LOD {
+	int level_for_scale(double scale);
+	int width(ALLEGRO_BITMAP *bitmap);
+	int height(ALLEGRO_BITMAP *bitmap);
+	void draw(ALLEGRO_BITMAP *bitmap, float dx, float dy, int flags);
+};
+
+#endif
@@ -0,0 +1,149 @@
+#include "LaneIndex.h"
+#include "../Level.h"
+#include "../shapes/Shape.h"
+#include "../shapes/Point.h"
+#include "../shapes/Rectangle.h"
+#include "../shapes/Circle.h"
+#include "../Utils.h"
+#include <algorithm>
+
+/**
+ * @brief Axis-aligned bounding box of a shape.
+ */
+static Rectangle
+bounding_box(const Shape &s) {
+	switch(s.getType()) {
+		case ShapeType::POINT: {
+			const Point &p = static_cast<const Point&>(s);
+			return Rectangle{p.x, p.y, p.x, p.y};
+		}
+		case ShapeType::RECTANGLE: return static_cast<const Rectangle&>(s);
+		case ShapeType::CIRCLE: {
+			const Circle &c = static_cast<const Circle&>(s);
+			return Rectangle{c.x - c.r, c.y - c.r, c.x + c.r, c.y + c.r};
+		}
+	}
+	GAME_ASSERT(false, "Unknown ShapeType.");
+}
+
+/**
+ * @brief Start an update. The objects inserted before it are kept, but an object that is not inserted again before find_pairs() is dropped.
+ * @details Everything is dropped when the level or its number of lanes changes.
+ */
+void
+LaneIndex::begin(const Level *level) {
+	GAME_ASSERT(swept, "find_pairs must be called once after every begin.");
+	size_t lanes = static_cast<size_t>(level->lane_count());
+	if(level != this->level || first.lanes.size() != lanes) {
+		for(Group *group : {&first, &second}) {
+			group->objects.clear();
+			group->lanes.assign(lanes, {});
+		}
+		this->level = level;
+	}
+	++updates;
+	swept = false;
+	pairs.clear();
+}
+
+/**
+ * @param key stable key of the object, e.g. its ObjectPool slot. Keys should be small, since the objects are stored by key.
+ * @param id id of the object in the pairs of this update, e.g. its index in its pool.
+ */
+void
+LaneIndex::insert_first(const Shape &shape, uint32_t key, size_t id) {
+	insert(first, shape, key, id);
+}
+
+void
+LaneIndex::insert_second(const Shape &shape, uint32_t key, size_t id) {
+	insert(second, shape, key, id);
+}
+
+/**
+ * @brief Refresh the box of an object, and add it to the buckets of the lanes it newly covers. It is removed from the lanes it left by refresh().
+ */
+void
+LaneIndex::insert(Group &group, const Shape &shape, uint32_t key, size_t id) {
+	if(key >= group.objects.size()) group.objects.resize(key + 1);
+	Object &o = group.objects[key];
+	const Rectangle &box = bounding_box(shape);
+	o.entry = Entry{box.x1, box.x2, level->lane_of(box.y1), level->lane_of(box.y2), id, key};
+	o.update = updates;
+	for(int lane = o.entry.lane_lo; lane <= o.entry.lane_hi; ++lane)
+		if(lane < o.member_lo || lane > o.member_hi) group.lanes[lane].emplace_back(o.entry);
+	o.member_lo = o.entry.lane_lo;
+	o.member_hi = o.entry.lane_hi;
+}
+
+/**
+ * @brief Find all pairs of (first, second) objects whose bounding boxes overlap.
+ * @return Pairs of ids given at insertion, sorted by first id and then second id. Each pair appears once even if both objects cover several lanes.
+ */
+const std::vector<std::pair<size_t, size_t>> &
+LaneIndex::find_pairs() {
+	for(size_t lane = 0; lane < first.lanes.size(); ++lane) {
+		refresh(first, static_cast<int>(lane));
+		refresh(second, static_cast<int>(lane));
+		sweep(static_cast<int>(lane));
+	}
+	swept = true;
+	std::sort(pairs.begin(), pairs.end());
+	return pairs;
+}
+
+/**
+ * @brief Bring the bucket of a lane up to date and sort it by x1.
+ * @details Entries of objects that were not inserted in this update, or that left the lane, are removed. The others take the box inserted in this update. The bucket is still in the order of the previous update, so an insertion sort only moves the objects that passed one another.
+ */
+void
+LaneIndex::refresh(Group &group, int lane) {
+	std::vector<Entry> &bucket = group.lanes[lane];
+	size_t n = 0;
+	for(const Entry &e : bucket) {
+		Object &o = group.objects[e.key];
+		if(o.update != updates) {
+			o.member_lo = 0;
+			o.member_hi = -1;
+			continue;
+		}
+		if(lane < o.entry.lane_lo || lane > o.entry.lane_hi) continue;
+		bucket[n++] = o.entry;
+	}
+	bucket.resize(n);
+	for(size_t i = 1; i < n; ++i) {
+		Entry e = bucket[i];
+		size_t j = i;
+		for(; j > 0 && bucket[j - 1].x1 > e.x1; --j) bucket[j] = bucket[j - 1];
+		bucket[j] = e;
+	}
+}
+
+/**
+ * @brief Sweep a lane from left to right and record the pairs whose x ranges overlap.
+ * @details Two objects covering several lanes meet in every lane they share, so a pair is only recorded in the topmost shared lane.
+ */
+void
+LaneIndex::sweep(int lane) {
+	std::vector<Entry> &first = this->first.lanes[lane];
+	std::vector<Entry> &second = this->second.lanes[lane];
+	if(first.empty() || second.empty()) return;
+	first_active.clear();
+	second_active.clear();
+	size_t i = 0, j = 0;
+	while(i < first.size() || j < second.size()) {
+		bool is_first = (j == second.size()) || (i < first.size() && first[i].x1 <= second[j].x1);
+		const Entry &e = is_first ? first[i++] : second[j++];
+		std::vector<Entry> &others = is_first ? second_active : first_active;
+		// Entries ending before e starts cannot overlap e or anything after e.
+		others.erase(
+			std::remove_if(others.begin(), others.end(), [&e](const Entry &o) { return o.x2 < e.x1; }),
+			others.end());
+		for(const Entry &o : others) {
+			if(std::max(e.lane_lo, o.lane_lo) != lane) continue;
+			if(is_first) pairs.emplace_back(e.id, o.id);
+			else pairs.emplace_back(o.id, e.id);
+		}
+		(is_first ? first_active : second_active).emplace_back(e);
+	}
+}
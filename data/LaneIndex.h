@@ -0,0 +1,74 @@
+#ifndef LANEINDEX_H_INCLUDED
+#define LANEINDEX_H_INCLUDED
+
+#include <vector>
+#include <utility>
+#include <cstddef>
+#include <cstdint>
+
+class Shape;
+class Level;
+
+/**
+ * @brief Lane-indexed broadphase for collision detection between two groups of objects.
+ * @details Every object of the game lives in one or more horizontal lanes of the level. Objects are bucketed by the lanes their bounding box covers, and each lane is swept along x to find the pairs whose bounding boxes overlap.
+ * Only these candidate pairs need the exact Shape::overlap check, so the cost grows close to linearly with the number of objects instead of (first group) × (second group).
+ * @details The index is kept from one update to the next. Objects are identified by a stable key, e.g. their ObjectPool slot, so an object stays in its lanes and in its place in the x order of each lane. Each update only refreshes the boxes, moves the objects that changed lanes, and restores the x order with an insertion sort, which is close to linear since objects move little between two updates.
+ * @details Every update must call begin(), insert the objects of both groups, then call find_pairs() once. An object that is not inserted is dropped by find_pairs().
+ * @see OperationCenter
+ */
+class LaneIndex
+{
+public:
+	void begin(const Level *level);
+	void insert_first(const Shape &shape, uint32_t key, size_t id);
+	void insert_second(const Shape &shape, uint32_t key, size_t id);
+	const std::vector<std::pair<size_t, size_t>> &find_pairs();
+private:
+	/**
+	 * @brief Bounding box of an object along x, the range of lanes it covers, and its id in the current update.
+	 */
+	struct Entry {
+		double x1, x2;
+		int lane_lo, lane_hi;
+		size_t id;
+		uint32_t key;
+	};
+	/**
+	 * @brief State of an object, indexed by its key.
+	 * @details member_lo and member_hi are the lanes whose buckets hold an entry of the object. The range is empty if it is in none.
+	 */
+	struct Object {
+		Entry entry;
+		unsigned long long update = 0;
+		int member_lo = 0, member_hi = -1;
+	};
+	/**
+	 * @brief Objects and lane buckets of one group.
+	 */
+	struct Group {
+		std::vector<Object> objects;
+		std::vector<std::vector<Entry>> lanes;
+	};
+	void insert(Group &group, const Shape &shape, uint32_t key, size_t id);
+	void refresh(Group &group, int lane);
+	void sweep(int lane);
+private:
+	const Level *level = nullptr;
+	/**
+	 * @brief Number of the current update. Objects inserted in it carry the same number.
+	 */
+	unsigned long long updates = 0;
+	bool swept = true;
+	Group first, second;
+	/**
+	 * @brief Entries of each group whose x range may still overlap the next entry of the sweep.
+	 */
+	std::vector<Entry> first_active, second_active;
+	/**
+	 * @brief Candidate pairs (first id, second id), sorted and without duplicates.
+	 */
+	std::vector<std::pair<size_t, size_t>> pairs;
+};
+
+#endif
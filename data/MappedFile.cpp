@@ -0,0 +1,72 @@
+#include "MappedFile.h"
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+/**
+ * @brief Map the file at path. Any previous mapping is closed.
+ * @return False if the file cannot be opened or is empty.
+ */
+bool
+MappedFile::open(const char *path) {
+	close();
+#ifdef _WIN32
+	HANDLE f = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if(f == INVALID_HANDLE_VALUE) return false;
+	LARGE_INTEGER file_size;
+	if(!GetFileSizeEx(f, &file_size) || file_size.QuadPart == 0) {
+		CloseHandle(f);
+		return false;
+	}
+	HANDLE m = CreateFileMappingA(f, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if(!m) {
+		CloseHandle(f);
+		return false;
+	}
+	void *p = MapViewOfFile(m, FILE_MAP_READ, 0, 0, 0);
+	if(!p) {
+		CloseHandle(m);
+		CloseHandle(f);
+		return false;
+	}
+	file = f;
+	mapping = m;
+	ptr = static_cast<const uint8_t*>(p);
+	length = static_cast<size_t>(file_size.QuadPart);
+#else
+	int fd = ::open(path, O_RDONLY);
+	if(fd < 0) return false;
+	struct stat st;
+	if(fstat(fd, &st) != 0 || st.st_size == 0) {
+		::close(fd);
+		return false;
+	}
+	void *p = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+	// The mapping stays valid after the descriptor is closed.
+	::close(fd);
+	if(p == MAP_FAILED) return false;
+	ptr = static_cast<const uint8_t*>(p);
+	length = static_cast<size_t>(st.st_size);
+#endif
+	return true;
+}
+
+void
+MappedFile::close() {
+	if(!ptr) return;
+#ifdef _WIN32
+	UnmapViewOfFile(ptr);
+	CloseHandle(static_cast<HANDLE>(mapping));
+	CloseHandle(static_cast<HANDLE>(file));
+	file = mapping = nullptr;
+#else
+	munmap(const_cast<uint8_t*>(ptr), length);
+#endif
+	ptr = nullptr;
+	length = 0;
+}
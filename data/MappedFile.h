@@ -0,0 +1,32 @@
+#ifndef MAPPEDFILE_H_INCLUDED
+#define MAPPEDFILE_H_INCLUDED
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * @brief Read-only memory mapping of a whole file.
+ * @details The pages are loaded by the OS on first access, so mapping a large file is cheap and only the parts that are read cost IO.
+ */
+class MappedFile
+{
+public:
+	MappedFile() {}
+	MappedFile(const MappedFile&) = delete;
+	MappedFile &operator=(const MappedFile&) = delete;
+	~MappedFile() { close(); }
+	bool open(const char *path);
+	void close();
+	bool is_open() const { return ptr != nullptr; }
+	const uint8_t *data() const { return ptr; }
+	size_t size() const { return length; }
+private:
+	const uint8_t *ptr = nullptr;
+	size_t length = 0;
+#ifdef _WIN32
+	void *file = nullptr;
+	void *mapping = nullptr;
+#endif
+};
+
+#endif
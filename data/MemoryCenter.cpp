@@ -0,0 +1,140 @@
+#include "MemoryCenter.h"
+#include "../Utils.h"
+#include "ImageCenter.h"
+#include "GIFCenter.h"
+#include "SoundCenter.h"
+
+/**
+ * @brief Account for an asset that has just been loaded. It counts as used now.
+ * @param bytes memory held by the asset, e.g. 4 bytes per pixel of a bitmap.
+ */
+void
+MemoryCenter::add(AssetKind kind, std::string_view path, size_t bytes) {
+	Entry &entry = intern(kind, path);
+	if(entry.loaded) used_bytes -= entry.bytes;
+	entry.bytes = bytes;
+	entry.loaded = true;
+	entry.last_use = updates;
+	used_bytes += bytes;
+	relist(entry);
+}
+
+/**
+ * @brief Stop accounting for an asset. Called by the centers whenever an asset is erased.
+ */
+void
+MemoryCenter::remove(AssetKind kind, std::string_view path) {
+	auto it = entries.find(KeyView{kind, path});
+	if(it == entries.end() || !it->second.loaded) return;
+	Entry &entry = it->second;
+	used_bytes -= entry.bytes;
+	entry.loaded = false;
+	unlist(entry);
+}
+
+/**
+ * @brief Mark an asset as used now. Called by the getters of the centers.
+ */
+void
+MemoryCenter::touch(AssetKind kind, std::string_view path) {
+	auto it = entries.find(KeyView{kind, path});
+	if(it == entries.end() || !it->second.loaded) return;
+	Entry &entry = it->second;
+	entry.last_use = updates;
+	if(entry.listed) lru.splice(lru.end(), lru, entry.lru_it);
+}
+
+/**
+ * @brief Keep an asset from being evicted. Pins are counted, so every pin() needs its own unpin().
+ */
+void
+MemoryCenter::pin(AssetKind kind, std::string_view path) {
+	Entry &entry = intern(kind, path);
+	if(entry.pins++ == 0) unlist(entry);
+}
+
+/**
+ * @brief Release a pin. An asset that is no longer pinned counts as used now.
+ */
+void
+MemoryCenter::unpin(AssetKind kind, std::string_view path) {
+	auto it = entries.find(KeyView{kind, path});
+	GAME_ASSERT(it != entries.end() && it->second.pins > 0, "unpin of an asset that is not pinned: %.*s.", static_cast<int>(path.size()), path.data());
+	Entry &entry = it->second;
+	if(--entry.pins > 0) return;
+	entry.last_use = updates;
+	relist(entry);
+}
+
+/**
+ * @brief Count an update, and evict assets while the budget is exceeded. Called once per update.
+ * @details Assets are visited from the least recently used one. The visit stops at the first asset used within MemorySetting::min_idle_updates, since every later one is more recent.
+ */
+void
+MemoryCenter::update() {
+	++updates;
+	auto it = lru.begin();
+	while(used_bytes > budget && it != lru.end()) {
+		// Advanced first, since evicting takes the entry out of the list.
+		Entry *entry = *it++;
+		if(entry->last_use > updates - MemorySetting::min_idle_updates) break;
+		if(evict(*entry->key))
+			debug_log("<MemoryCenter> evict %s, %zu KB in use.\n", entry->key->second.c_str(), used_bytes >> 10);
+	}
+}
+
+/**
+ * @brief Find the entry of a path, or create it.
+ */
+MemoryCenter::Entry&
+MemoryCenter::intern(AssetKind kind, std::string_view path) {
+	auto it = entries.find(KeyView{kind, path});
+	if(it == entries.end()) {
+		it = entries.emplace(Key{kind, std::string{path}}, Entry{}).first;
+		it->second.key = &it->first;
+		it->second.lru_it = parked.insert(parked.end(), &it->second);
+	}
+	return it->second;
+}
+
+/**
+ * @brief Move an entry to the most recent end of lru if it can be evicted, or take it out otherwise.
+ */
+void
+MemoryCenter::relist(Entry &entry) {
+	if(!entry.loaded || entry.pins > 0 || entry.key->first == AssetKind::FRAME) {
+		unlist(entry);
+		return;
+	}
+	lru.splice(lru.end(), entry.listed ? lru : parked, entry.lru_it);
+	entry.listed = true;
+}
+
+void
+MemoryCenter::unlist(Entry &entry) {
+	if(!entry.listed) return;
+	parked.splice(parked.end(), lru, entry.lru_it);
+	entry.listed = false;
+}
+
+/**
+ * @brief Erase an asset from its center, which calls remove().
+ * @return False if the asset cannot be erased now.
+ */
+bool
+MemoryCenter::evict(const Key &key) {
+	const std::string &path = key.second;
+	switch(key.first) {
+		case AssetKind::IMAGE: {
+			return ImageCenter::get_instance()->erase(path);
+		} case AssetKind::GIF: {
+			return GIFCenter::get_instance()->erase(path);
+		} case AssetKind::SOUND: {
+			SoundCenter *SC = SoundCenter::get_instance();
+			return !SC->in_use(path) && SC->erase_sample(path);
+		} case AssetKind::FRAME: {
+			return false;
+		}
+	}
+	return false;
+}
@@ -0,0 +1,109 @@
+#ifndef MEMORYCENTER_H_INCLUDED
+#define MEMORYCENTER_H_INCLUDED
+
+#include <map>
+#include <list>
+#include <string>
+#include <string_view>
+#include <utility>
+
+// fixed settings
+namespace MemorySetting {
+	/**
+	 * @brief Default upper bound of the memory held by loaded assets, in bytes. Can be changed with --memory-budget.
+	 */
+	constexpr size_t budget = 256 << 20;
+	/**
+	 * @brief An asset used within this many updates is never evicted, even over the budget.
+	 */
+	constexpr long min_idle_updates = 120;
+};
+
+enum class AssetKind {
+	IMAGE,
+	GIF,
+	SOUND,
+	/**
+	 * @brief A frame bitmap shared by several GIFs, see GIFCenter. It is never evicted itself, and is freed when the last GIF that uses it is erased.
+	 */
+	FRAME
+};
+
+/**
+ * @brief Keeps the assets loaded by ImageCenter, GIFCenter and SoundCenter within a memory budget.
+ * @details Every center reports the size of an asset when it is loaded (add()), used (touch()) and removed (remove()). Once per update, the least recently used assets are erased from their center until the total fits in the budget again. An evicted asset is loaded again by the next get() of its center.
+ * @details An asset is never evicted while it is pinned. Whoever keeps a pointer returned by a center, instead of getting it again when it is used, must pin the path for as long as the pointer is kept, e.g. from the constructor to the destructor of an object. PreloadCenter pins every asset of the manifest of the current level.
+ * @details Samples with a playing instance are skipped as well.
+ * @details Paths are looked up as std::string_view, so the calls made on every get() and by every bullet never copy the path.
+ * @details Only used on the main thread.
+ */
+class MemoryCenter
+{
+public:
+	static MemoryCenter *get_instance() {
+		static MemoryCenter MC;
+		return &MC;
+	}
+	void add(AssetKind kind, std::string_view path, size_t bytes);
+	void remove(AssetKind kind, std::string_view path);
+	void touch(AssetKind kind, std::string_view path);
+	void pin(AssetKind kind, std::string_view path);
+	void unpin(AssetKind kind, std::string_view path);
+	void update();
+	size_t used() const { return used_bytes; }
+public:
+	/**
+	 * @brief Current budget in bytes.
+	 */
+	size_t budget = MemorySetting::budget;
+private:
+	MemoryCenter() {}
+	typedef std::pair<AssetKind, std::string> Key;
+	typedef std::pair<AssetKind, std::string_view> KeyView;
+	/**
+	 * @brief Orders keys by kind then path, and compares a Key with a KeyView without building a Key.
+	 */
+	struct KeyLess {
+		using is_transparent = void;
+		template<typename A, typename B>
+		bool operator()(const A &a, const B &b) const {
+			if(a.first != b.first) return a.first < b.first;
+			return std::string_view{a.second} < std::string_view{b.second};
+		}
+	};
+	/**
+	 * @brief State of a path that has been loaded or pinned.
+	 * @details Entries are kept once created, so loading or pinning the same path again does not allocate.
+	 */
+	struct Entry {
+		const Key *key = nullptr;
+		size_t bytes = 0;
+		long last_use = 0;
+		int pins = 0;
+		bool loaded = false;
+		/**
+		 * @brief Whether lru_it is in lru rather than in parked.
+		 */
+		bool listed = false;
+		std::list<Entry*>::iterator lru_it;
+	};
+	Entry &intern(AssetKind kind, std::string_view path);
+	void relist(Entry &entry);
+	void unlist(Entry &entry);
+	bool evict(const Key &key);
+private:
+	std::map<Key, Entry, KeyLess> entries;
+	/**
+	 * @brief Entries that can be evicted, from the least to the most recently used: loaded, not pinned and not AssetKind::FRAME.
+	 * @details Pinned assets and shared frames are never candidates, so they are left out instead of being skipped on every update.
+	 */
+	std::list<Entry*> lru;
+	/**
+	 * @brief List nodes of the other entries. Nodes are spliced between both lists, so pinning and unpinning never allocate.
+	 */
+	std::list<Entry*> parked;
+	size_t used_bytes = 0;
+	long updates = 0;
+};
+
+#endif
@@ -0,0 +1,130 @@
+#ifndef OBJECTPOOL_H_INCLUDED
+#define OBJECTPOOL_H_INCLUDED
+
+#include <vector>
+#include <memory>
+#include <new>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <type_traits>
+#include "../Utils.h"
+
+/**
+ * @brief Slab pool that owns game objects of a class family (e.g. Monster and its subclasses).
+ * @details Objects are constructed in place inside fixed-size slots, allocated by chunks of chunk_slots. A removed object releases its slot to be recycled by the next emplace, so once the pool is warmed up, creating and removing objects does not touch the allocator.
+ * Live objects are also listed in a dense array that can be iterated like the original std::vector<T*>. Removal swaps the last object into the hole, so it is O(1) but does not preserve the order.
+ * A Handle stays valid until its object is removed. After that, get() returns nullptr for it even if the slot has been reused, because every reuse bumps the slot generation.
+ * @tparam T base class of the stored objects. The destructor must be virtual if subclasses are stored.
+ */
+template<typename T>
+class ObjectPool
+{
+public:
+	/**
+	 * @brief Generational reference to an object in the pool.
+	 */
+	struct Handle {
+		uint32_t slot = UINT32_MAX;
+		uint32_t generation = 0;
+	};
+	/**
+	 * @param slot_size the size of the largest class that will be emplaced.
+	 */
+	explicit ObjectPool(size_t slot_size) :
+		stride((slot_size + alignof(std::max_align_t) - 1) / alignof(std::max_align_t) * alignof(std::max_align_t)) {}
+	ObjectPool(const ObjectPool&) = delete;
+	ObjectPool &operator=(const ObjectPool&) = delete;
+	~ObjectPool() { clear(); }
+	/**
+	 * @brief Construct an object of class D in a free slot.
+	 * @return Handle of the new object.
+	 */
+	template<typename D = T, typename ...Args>
+	Handle emplace(Args &&...args) {
+		static_assert(std::is_base_of<T, D>::value, "D must derive from T.");
+		static_assert(alignof(D) <= alignof(std::max_align_t), "D is over-aligned.");
+		GAME_ASSERT(sizeof(D) <= stride, "object of size %zu does not fit in pool slot of size %zu.", sizeof(D), stride);
+		if(free_slots.empty()) grow();
+		uint32_t slot = free_slots.back();
+		free_slots.pop_back();
+		T *obj = new(slot_ptr(slot)) D(std::forward<Args>(args)...);
+		dense_index[slot] = static_cast<uint32_t>(dense.size());
+		dense.emplace_back(obj);
+		dense_slot.emplace_back(slot);
+		return Handle{slot, generations[slot]};
+	}
+	/**
+	 * @return The object referenced by h, or nullptr if it has been removed.
+	 */
+	T *get(Handle h) const {
+		if(h.slot >= generations.size() || generations[h.slot] != h.generation) return nullptr;
+		return dense[dense_index[h.slot]];
+	}
+	Handle handle_at(size_t i) const {
+		uint32_t slot = dense_slot[i];
+		return Handle{slot, generations[slot]};
+	}
+	void remove(Handle h) {
+		if(get(h) == nullptr) return;
+		remove_at(dense_index[h.slot]);
+	}
+	/**
+	 * @brief Destroy the i-th object of the dense array. The last object is moved to index i.
+	 */
+	void remove_at(size_t i) {
+		uint32_t slot = dense_slot[i];
+		dense[i]->~T();
+		++generations[slot];
+		free_slots.emplace_back(slot);
+		dense[i] = dense.back();
+		dense_slot[i] = dense_slot.back();
+		dense_index[dense_slot[i]] = static_cast<uint32_t>(i);
+		dense.pop_back();
+		dense_slot.pop_back();
+	}
+	/**
+	 * @brief Destroy all objects. The slots are kept for reuse.
+	 */
+	void clear() {
+		while(!dense.empty()) remove_at(dense.size() - 1);
+	}
+	size_t size() const { return dense.size(); }
+	bool empty() const { return dense.empty(); }
+	T *operator[](size_t i) const { return dense[i]; }
+	T *const *begin() const { return dense.data(); }
+	T *const *end() const { return dense.data() + dense.size(); }
+private:
+	static constexpr size_t chunk_slots = 64;
+	void *slot_ptr(uint32_t slot) {
+		return reinterpret_cast<unsigned char*>(chunks[slot / chunk_slots].get()) + slot % chunk_slots * stride;
+	}
+	void grow() {
+		size_t first = chunks.size() * chunk_slots;
+		chunks.emplace_back(new std::max_align_t[(chunk_slots * stride + sizeof(std::max_align_t) - 1) / sizeof(std::max_align_t)]);
+		generations.resize(first + chunk_slots, 0);
+		dense_index.resize(first + chunk_slots, 0);
+		// Push in reverse so that slots are handed out in increasing order.
+		for(size_t i = first + chunk_slots; i-- > first; )
+			free_slots.emplace_back(static_cast<uint32_t>(i));
+	}
+private:
+	/**
+	 * @brief Size of a slot in bytes, rounded up to the maximum fundamental alignment.
+	 */
+	size_t stride;
+	std::vector<std::unique_ptr<std::max_align_t[]>> chunks;
+	/**
+	 * @brief Per-slot generation and position in the dense array.
+	 */
+	std::vector<uint32_t> generations;
+	std::vector<uint32_t> dense_index;
+	std::vector<uint32_t> free_slots;
+	/**
+	 * @brief Live objects and their slots, in iteration order.
+	 */
+	std::vector<T*> dense;
+	std::vector<uint32_t> dense_slot;
+};
+
+#endif
@@ -9,6 +9,18 @@
 #include "../sun.h"
 #include <iostream>
 //revise end
+#include <allegro5/bitmap_draw.h>
+
+/**
+ * @brief Remove the objects marked in removed from the pool.
+ * @details Going backwards, the object swapped into a hole has always been visited already.
+ */
+template<typename T>
+static void
+erase_removed(ObjectPool<T> &objs, const std::vector<bool> &removed) {
+	for(size_t i = objs.size(); i-- > 0; )
+		if(removed[i]) objs.remove_at(i);
+}
 
 void OperationCenter::update() {
 	// Update monsters.
@@ -30,25 +42,27 @@ void OperationCenter::update() {
 }
 
 void OperationCenter::_update_monster() {
-	std::vector<Monster*> &monsters = DataCenter::get_instance()->monsters;
+	ObjectPool<Monster> &monsters = DataCenter::get_instance()->monsters;
 	for(Monster *monster : monsters)
 		monster->update();
 }
 
 void OperationCenter::_update_tower() {
-	std::vector<Tower*> &towers = DataCenter::get_instance()->towers;
-	for(Tower *tower : towers)
+	ObjectPool<Tower> &towers = DataCenter::get_instance()->towers;
+	for(Tower *tower : towers) {
+		tower->update_animation();
 		tower->update();
+	}
 }
 
 void OperationCenter::_update_towerBullet() {
-	std::vector<Bullet*> &towerBullets = DataCenter::get_instance()->towerBullets;
+	ObjectPool<Bullet> &towerBullets = DataCenter::get_instance()->towerBullets;
 	for(Bullet *towerBullet : towerBullets)
 		towerBullet->update();
 	// Detect if a bullet flies too far (exceeds its fly distance limit), which means the bullet lifecycle has ended.
 	for(size_t i = 0; i < towerBullets.size(); ++i) {
 		if(towerBullets[i]->get_fly_dist() <= 0) {
-			towerBullets.erase(towerBullets.begin()+i);
+			towerBullets.remove_at(i);
 			--i;
 		}
 	}
@@ -56,68 +70,78 @@ void OperationCenter::_update_towerBullet() {
 
 void OperationCenter::_update_monster_towerBullet() {
 	DataCenter *DC = DataCenter::get_instance();
-	std::vector<Monster*> &monsters = DC->monsters;
-	std::vector<Bullet*> &towerBullets = DC->towerBullets;
-	for(size_t i = 0; i < monsters.size(); ++i) {
-		for(size_t j = 0; j < towerBullets.size(); ++j) {
-			// Check if the bullet overlaps with the monster.
-			if(monsters[i]->get_region().overlap(*(towerBullets[j]->shape))) {
-				monsters[i]->is_hit = true;
-				monsters[i]->hit_timer = 0.3;
-				monsters[i]->brightness = 1.5;
-				// Reduce the HP of the monster. Delete the bullet.
-				monsters[i]->HP -= towerBullets[j]->get_dmg();
-				towerBullets.erase(towerBullets.begin()+j);
-				--j;
-				if(monsters[i]->HP <=0 && !monsters[i]->dead){
-					monsters[i]->die(1);
-					break;
-				}
+	ObjectPool<Monster> &monsters = DC->monsters;
+	ObjectPool<Bullet> &towerBullets = DC->towerBullets;
+	bullet_index.begin(DC->level);
+	for(size_t i = 0; i < monsters.size(); ++i)
+		bullet_index.insert_first(monsters[i]->get_region(), monsters.handle_at(i).slot, i);
+	for(size_t j = 0; j < towerBullets.size(); ++j)
+		bullet_index.insert_second(*(towerBullets[j]->shape), towerBullets.handle_at(j).slot, j);
+	removed.assign(towerBullets.size(), false);
+	// Pairs come sorted by monster, so a monster killed here can skip its remaining pairs.
+	size_t killed = monsters.size();
+	for(const auto &[i, j] : bullet_index.find_pairs()) {
+		if(i == killed || removed[j]) continue;
+		// Check if the bullet overlaps with the monster.
+		if(monsters[i]->get_region().overlap(*(towerBullets[j]->shape))) {
+			monsters[i]->is_hit = true;
+			monsters[i]->hit_timer = 0.3;
+			monsters[i]->brightness = 1.5;
+			// Reduce the HP of the monster. Delete the bullet.
+			monsters[i]->HP -= towerBullets[j]->get_dmg();
+			removed[j] = true;
+			if(monsters[i]->HP <=0 && !monsters[i]->dead){
+				monsters[i]->die(1);
+				killed = i;
 			}
 		}
 	}
+	erase_removed(towerBullets, removed);
 }
 
 //revise
 
 void OperationCenter::_update_monster_tower() {
 	DataCenter *DC = DataCenter::get_instance();
-	std::vector<Monster*> &monsters = DC->monsters;
-	std::vector<Tower*> &towers = DC->towers;
-	Player *&player = DC->player;
-	for(size_t i = 0; i < monsters.size(); ++i) {
-		for(size_t j = 0; j < towers.size(); ++j) {
-			// Check if the plant overlaps with the monster.
-			if(monsters[i]->get_region().overlap(towers[j]->get_region())) {
-				if(towers[j]->type == TowerType::POISON)
-				{
-					std::cout << "bomb\n" ;
-					monsters[i]->HP = 0;
-					if(!monsters[i]->dead){
-						monsters[i]->die(0);
-					}
-                    towers.erase(towers.begin() + j);
-                    --j;
-                    break;
+	ObjectPool<Monster> &monsters = DC->monsters;
+	ObjectPool<Tower> &towers = DC->towers;
+	tower_index.begin(DC->level);
+	for(size_t i = 0; i < monsters.size(); ++i)
+		tower_index.insert_first(monsters[i]->get_region(), monsters.handle_at(i).slot, i);
+	for(size_t j = 0; j < towers.size(); ++j)
+		tower_index.insert_second(towers[j]->get_region(), towers.handle_at(j).slot, j);
+	removed.assign(towers.size(), false);
+	size_t bombed = monsters.size();
+	for(const auto &[i, j] : tower_index.find_pairs()) {
+		if(i == bombed || removed[j]) continue;
+		// Check if the plant overlaps with the monster.
+		if(monsters[i]->get_region().overlap(towers[j]->get_region())) {
+			if(towers[j]->type == TowerType::POISON)
+			{
+				std::cout << "bomb\n" ;
+				monsters[i]->HP = 0;
+				if(!monsters[i]->dead){
+					monsters[i]->die(0);
 				}
-				else{
-					monsters[i]->eating();
-					towers[j]->hp -= 1;
-					if(towers[j]->hp <= 0) {
-						towers.erase(towers.begin()+j);
-						--j;
-						monsters[i]->resume();
-						// Since the current plant is killed, we can directly proceed to next monster.
-					}
+				removed[j] = true;
+				bombed = i;
+			}
+			else{
+				monsters[i]->eating();
+				towers[j]->hp -= 1;
+				if(towers[j]->hp <= 0) {
+					removed[j] = true;
+					monsters[i]->resume();
 				}
 			}
 		}
 	}
+	erase_removed(towers, removed);
 }
 
 void OperationCenter::_update_monster_player() {
 	DataCenter *DC = DataCenter::get_instance();
-	std::vector<Monster*> &monsters = DC->monsters;
+	ObjectPool<Monster> &monsters = DC->monsters;
 	Player *&player = DC->player;
 	for(size_t i = 0; i < monsters.size(); ++i) {
 		// Check if the monster is killed.
@@ -126,13 +150,13 @@ void OperationCenter::_update_monster_player() {
 		}
 		if (monsters[i]->is_dead()) {
 			//player->coin += monsters[i]->get_money();
-            monsters.erase(monsters.begin()+i);
+            monsters.remove_at(i);
 			--i;
             break; 
         }
 		// Check if the monster reaches the end.
 		if(monsters[i]->get_path().empty()) {
-			monsters.erase(monsters.begin()+i);
+			monsters.remove_at(i);
 			player->HP--;
 			--i;
 		}
@@ -144,17 +168,19 @@ void OperationCenter::_update_monster_player() {
 void OperationCenter::_update_monster_hero()
 {
 	DataCenter *DC = DataCenter::get_instance();
-	std::vector<Monster *> &monsters = DC->monsters;
-	for (size_t i = 0; i < monsters.size(); ++i)
-	{
-		for(int j = 0; j<5; j++){
-			if (monsters[i]->shape->overlap(*(DC->heros[j]->shape)))
-			{
-				monsters[i]->HP = 0;
-				if(!monsters[i]->dead)
-					monsters[i]->die(1);
-				DC->heros[j]->state = HeroState::GO;
-			}
+	ObjectPool<Monster> &monsters = DC->monsters;
+	hero_index.begin(DC->level);
+	for(size_t i = 0; i < monsters.size(); ++i)
+		hero_index.insert_first(*(monsters[i]->shape), monsters.handle_at(i).slot, i);
+	for(size_t j = 0; j < 5; ++j)
+		hero_index.insert_second(*(DC->heros[j]->shape), static_cast<uint32_t>(j), j);
+	for(const auto &[i, j] : hero_index.find_pairs()) {
+		if (monsters[i]->shape->overlap(*(DC->heros[j]->shape)))
+		{
+			monsters[i]->HP = 0;
+			if(!monsters[i]->dead)
+				monsters[i]->die(1);
+			DC->heros[j]->state = HeroState::GO;
 		}
 	}
 }
@@ -163,15 +189,26 @@ void OperationCenter::_update_monster_hero()
 void OperationCenter::_cherrybomb()
 {
 	DataCenter *DC = DataCenter::get_instance();
-	std::vector<Monster *> &monsters = DC->monsters;
-	std::vector<Tower*> &towers = DC->towers;
+	ObjectPool<Monster> &monsters = DC->monsters;
+	ObjectPool<Tower> &towers = DC->towers;
+	// Only the monsters near the attack range of a bomb are checked against it.
+	bomb_index.begin(DC->level);
+	for(size_t j = 0; j < towers.size(); ++j)
+		if(towers[j]->type == TowerType::STORM)
+			bomb_index.insert_first(towers[j]->get_attack_range(), towers.handle_at(j).slot, j);
+	for(size_t i = 0; i < monsters.size(); ++i)
+		bomb_index.insert_second(*(monsters[i]->shape), monsters.handle_at(i).slot, i);
+	// Pairs come sorted by tower.
+	const std::vector<std::pair<size_t, size_t>> &pairs = bomb_index.find_pairs();
+	size_t p = 0;
 	for(size_t j = 0; j < towers.size(); ++j){
 		if(towers[j]->type == TowerType::STORM){
 			bool bombed = false;
 			towers[j]->placed_time++;
-			for (size_t i = 0; i < monsters.size(); ++i)
+			for(; p < pairs.size() && pairs[p].first < j; ++p) {}
+			for(; p < pairs.size() && pairs[p].first == j; ++p)
 			{
-				
+				size_t i = pairs[p].second;
 				if (monsters[i]->shape->overlap(towers[j]->get_attack_range()))
 				{
 					bombed = true;
@@ -183,7 +220,7 @@ void OperationCenter::_cherrybomb()
 				
 			}
 			if(bombed||towers[j]->placed_time>= 2*DC->FPS){
-					towers.erase(towers.begin()+j);
+					towers.remove_at(j);
 					--j;
 					break;
 			}
@@ -195,38 +232,44 @@ void OperationCenter::_cherrybomb()
 
 void OperationCenter::_update_sun()
 {
-	std::vector<Sun *> &suns = DataCenter::get_instance()->suns;
+	ObjectPool<Sun> &suns = DataCenter::get_instance()->suns;
 	for(Sun *sun : suns)
 		sun->update();
 }
 
+/**
+ * @brief Draw all game objects.
+ * @details Drawing is held, so sprites that come from the same atlas page are sent to the GPU in one batch. Objects that change the render state must release the hold around it.
+ */
 void OperationCenter::draw() {
+	al_hold_bitmap_drawing(true);
 	_draw_monster();
 	_draw_tower();
 	_draw_towerBullet();
 	_draw_sun();
+	al_hold_bitmap_drawing(false);
 }
 
 void OperationCenter::_draw_monster() {
-	std::vector<Monster*> &monsters = DataCenter::get_instance()->monsters;
+	ObjectPool<Monster> &monsters = DataCenter::get_instance()->monsters;
 	for(Monster *monster : monsters)
 		monster->draw();
 }
 
 void OperationCenter::_draw_tower() {
-	std::vector<Tower*> &towers = DataCenter::get_instance()->towers;
+	ObjectPool<Tower> &towers = DataCenter::get_instance()->towers;
 	for(Tower *tower : towers)
 		tower->draw();
 }
 
 void OperationCenter::_draw_towerBullet() {
-	std::vector<Bullet*> &towerBullets = DataCenter::get_instance()->towerBullets;
+	ObjectPool<Bullet> &towerBullets = DataCenter::get_instance()->towerBullets;
 	for(Bullet *towerBullet : towerBullets)
 		towerBullet->draw();
 }
 
 void OperationCenter::_draw_sun() {
-    std::vector<Sun *> &suns = DataCenter::get_instance()->suns;
+    ObjectPool<Sun> &suns = DataCenter::get_instance()->suns;
 	for(Sun *sun : suns)
 		sun->draw();
 }
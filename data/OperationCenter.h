@@ -1,6 +1,8 @@
 #ifndef OPERATIONCENTER_H_INCLUDED
 #define OPERATIONCENTER_H_INCLUDED
 #include <allegro5/allegro.h>
+#include "LaneIndex.h"
+#include <vector>
 /**
  * @brief Class that defines functions for all object operations.
  * @details Object self-update, draw, and object-to-object interact functions are defined here.
@@ -43,6 +45,15 @@ private:
 	void _draw_towerBullet();
 	void _draw_sun();  
 	void _cherrybomb();
+private:
+	/**
+	 * @brief Broadphase of each monster-to-object collision check. Each one is kept from one update to the next, see LaneIndex.
+	 */
+	LaneIndex bullet_index, tower_index, hero_index, bomb_index;
+	/**
+	 * @brief Marks objects removed during a collision check, so they can be erased in one pass afterwards.
+	 */
+	std::vector<bool> removed;
 };
 
 #endif
@@ -0,0 +1,120 @@
+#include "PreloadCenter.h"
+#include <allegro5/allegro.h>
+#include <algorithm>
+#include <cstdio>
+#include <sstream>
+#include "../Utils.h"
+#include "GIFCenter.h"
+#include "ImageCenter.h"
+#include "SoundCenter.h"
+#include "MemoryCenter.h"
+
+/**
+ * @brief Read the manifest of a level and start preloading its GIFs. Returns immediately.
+ * @details Without a manifest nothing is preloaded, and the assets are loaded when they are first used.
+ * @details The assets of the manifest are pinned in MemoryCenter until the next level is started, and the ones of the previous level are unpinned.
+ * @param lvl level index.
+ */
+void
+PreloadCenter::start(int lvl) {
+	std::vector<std::pair<AssetKind, std::string>> previous;
+	previous.swap(pinned);
+	items.clear();
+	gifs.clear();
+	gifs_done = true;
+	total = 0;
+	// Called after the new level is pinned, so that the assets shared by both levels are never evictable in between.
+	auto unpin_previous = [&previous]() {
+		for(auto &[kind, path] : previous) MemoryCenter::get_instance()->unpin(kind, path);
+	};
+
+	char buffer[50];
+	sprintf(buffer, PreloadSetting::manifest_path_format, lvl);
+	ALLEGRO_FILE *f = al_fopen(buffer, "rb");
+	if(!f) {
+		debug_log("<PreloadCenter> %s not found, assets are loaded on demand.\n", buffer);
+		unpin_previous();
+		return;
+	}
+	std::string text;
+	char chunk[256];
+	while(size_t n = al_fread(f, chunk, sizeof(chunk))) text.append(chunk, n);
+	al_fclose(f);
+
+	std::istringstream lines(text);
+	std::string line;
+	while(std::getline(lines, line)) {
+		std::istringstream in(line);
+		std::string kind, path;
+		if(!(in >> kind) || kind[0] == '#') continue;
+		in >> path;
+		if(kind == "gif") gifs.emplace_back(path);
+		else if(kind == "image") items.push_back(Item{Kind::IMAGE, path});
+		else if(kind == "sound") items.push_back(Item{Kind::SOUND, path});
+		else debug_log("<PreloadCenter> %s: unknown kind %s.\n", buffer, kind.c_str());
+	}
+	for(const std::string &path : gifs) pinned.emplace_back(AssetKind::GIF, path);
+	for(const Item &item : items)
+		pinned.emplace_back(item.kind == Kind::IMAGE ? AssetKind::IMAGE : AssetKind::SOUND, item.path);
+	for(auto &[kind, path] : pinned) MemoryCenter::get_instance()->pin(kind, path);
+	unpin_previous();
+	total = gifs.size() + items.size();
+	gifs_done = gifs.empty();
+	GIFCenter::get_instance()->preload(gifs);
+	debug_log("<PreloadCenter> preload %zu assets of level %d.\n", total, lvl);
+}
+
+/**
+ * @brief Upload the GIFs decoded so far, then load images and sounds until the budget is spent. Called once per update.
+ * @param budget time in seconds. At least one asset is loaded if any is ready.
+ * @return True if all assets of the manifest are loaded.
+ */
+bool
+PreloadCenter::update(double budget) {
+	double deadline = al_get_time() + budget;
+	gifs_done = GIFCenter::get_instance()->poll(budget);
+	bool first = true;
+	while(!items.empty() && (first || al_get_time() < deadline)) {
+		load(items.front());
+		items.pop_front();
+		first = false;
+	}
+	return done();
+}
+
+/**
+ * @brief Load every remaining asset now, waiting for the GIF workers.
+ */
+void
+PreloadCenter::finish() {
+	for(const Item &item : items) load(item);
+	items.clear();
+	GIFCenter *GIFC = GIFCenter::get_instance();
+	for(const std::string &path : gifs) GIFC->get(path);
+	gifs_done = true;
+}
+
+/**
+ * @brief Fraction of the assets of the manifest that are loaded, from 0 to 1.
+ */
+double
+PreloadCenter::progress() const {
+	if(total == 0) return 1;
+	GIFCenter *GIFC = GIFCenter::get_instance();
+	size_t loaded = total - items.size() - gifs.size();
+	loaded += std::count_if(gifs.begin(), gifs.end(), [GIFC](const std::string &path) { return GIFC->is_loaded(path); });
+	return static_cast<double>(loaded) / total;
+}
+
+void
+PreloadCenter::load(const Item &item) {
+	switch(item.kind) {
+		case Kind::IMAGE: {
+			ImageCenter::get_instance()->get(item.path);
+			break;
+		} case Kind::SOUND: {
+			SoundCenter::get_instance()->load(item.path);
+			break;
+		}
+	}
+}
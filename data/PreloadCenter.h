@@ -0,0 +1,63 @@
+#ifndef PRELOADCENTER_H_INCLUDED
+#define PRELOADCENTER_H_INCLUDED
+
+#include <deque>
+#include <vector>
+#include <string>
+#include <utility>
+#include "MemoryCenter.h"
+
+// fixed settings
+namespace PreloadSetting {
+	constexpr char manifest_path_format[] = "./assets/level/LEVEL%d.manifest";
+	/**
+	 * @brief Time spent on loading per update, in seconds. A single asset may take longer.
+	 */
+	constexpr double frame_budget = 0.004;
+};
+
+/**
+ * @brief Loads the assets of a level before it is played.
+ * @details Every level has a manifest next to its level file. Each line of the manifest is `<kind> <path>`, where kind is gif, image or sound, and path is written exactly as the game requests the asset. Empty lines and lines starting with # are skipped.
+ * @details GIFs are decoded by the workers of GIFCenter. Their upload, and the loading of images and sounds, runs in update() within PreloadSetting::frame_budget, so the game keeps drawing while the level is loading.
+ * @details Fonts are not listed, since FontCenter loads all of them at startup.
+ * @details The assets of the current level are pinned in MemoryCenter, so they are never evicted while it is played.
+ */
+class PreloadCenter
+{
+public:
+	static PreloadCenter *get_instance() {
+		static PreloadCenter PC;
+		return &PC;
+	}
+	void start(int lvl);
+	bool update(double budget = PreloadSetting::frame_budget);
+	void finish();
+	bool done() const { return items.empty() && gifs_done; }
+	double progress() const;
+private:
+	PreloadCenter() {}
+	enum class Kind { IMAGE, SOUND };
+	struct Item {
+		Kind kind;
+		std::string path;
+	};
+	void load(const Item &item);
+private:
+	/**
+	 * @brief Images and sounds that are not loaded yet.
+	 */
+	std::deque<Item> items;
+	/**
+	 * @brief GIFs of the manifest, preloaded by GIFCenter.
+	 */
+	std::vector<std::string> gifs;
+	bool gifs_done = true;
+	size_t total = 0;
+	/**
+	 * @brief Assets of the manifest of the current level, pinned in MemoryCenter.
+	 */
+	std::vector<std::pair<AssetKind, std::string>> pinned;
+};
+
+#endif
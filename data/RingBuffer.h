@@ -0,0 +1,52 @@
+#ifndef RINGBUFFER_H_INCLUDED
+#define RINGBUFFER_H_INCLUDED
+
+#include <atomic>
+#include <cstddef>
+#include <type_traits>
+
+/**
+ * @brief Lock-free queue of fixed capacity between one producer thread and one consumer thread.
+ * @details push() is only called by the producer and pop() only by the consumer. Neither of them waits: push() fails when the queue is full and pop() fails when it is empty.
+ * The slots are constructed once, and elements are copied in and out of them. Elements must be trivially copyable, so that neither thread touches the allocator.
+ * @tparam T element type, trivially copyable.
+ * @tparam N capacity, a power of two.
+ */
+template<typename T, size_t N>
+class RingBuffer
+{
+	static_assert(N > 0 && (N & (N - 1)) == 0, "capacity must be a power of two.");
+	static_assert(std::is_trivially_copyable_v<T>, "elements must be trivially copyable.");
+public:
+	/**
+	 * @return False if the queue is full, in which case the element is not queued.
+	 */
+	bool push(const T &value) {
+		size_t t = tail.load(std::memory_order_relaxed);
+		if(t - head.load(std::memory_order_acquire) == N) return false;
+		slots[t & (N - 1)] = value;
+		// Publishes the slot to the consumer.
+		tail.store(t + 1, std::memory_order_release);
+		return true;
+	}
+	/**
+	 * @return False if the queue is empty, in which case value is left unchanged.
+	 */
+	bool pop(T &value) {
+		size_t h = head.load(std::memory_order_relaxed);
+		if(h == tail.load(std::memory_order_acquire)) return false;
+		value = slots[h & (N - 1)];
+		// Hands the slot back to the producer.
+		head.store(h + 1, std::memory_order_release);
+		return true;
+	}
+private:
+	T slots[N];
+	/**
+	 * @brief Counts of popped and pushed elements. They are on separate cache lines, so that the two threads do not invalidate each other's line on every operation.
+	 */
+	alignas(64) std::atomic<size_t> head{0};
+	alignas(64) std::atomic<size_t> tail{0};
+};
+
+#endif
@@ -1,27 +1,72 @@
 #include "SoundCenter.h"
 #include "../Utils.h"
+#include "../Benchmark.h"
+#include "DataCenter.h"
+#include "MemoryCenter.h"
+#include "SpritePack.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
 
 using namespace std;
 
 // fixed settings
 namespace SoundSetting {
 	constexpr int RESERVED_SAMPLES = 16;
-	constexpr int UPDATE_PERIOD = 60;
+	/**
+	 * @brief Instances created with every sample, so that its first plays allocate nothing either.
+	 */
+	constexpr int PREALLOCATED_INSTANCES = 2;
+	/**
+	 * @brief Voices playing at once, looping ones included.
+	 */
+	constexpr int MAX_VOICES = 12;
+	constexpr int MAX_VOICES_PER_SAMPLE = 4;
+	/**
+	 * @brief Gain of a voice that many plays are coalesced into. Sounds that are not in phase add up in power, so n plays get a gain of sqrt(n), up to this value.
+	 */
+	constexpr float MAX_COALESCED_GAIN = 2.0f;
+	/**
+	 * @brief Buffers of a music stream and samples per buffer. Together they hold about 0.2 seconds of audio.
+	 */
+	constexpr int MUSIC_BUFFER_COUNT = 4;
+	constexpr int MUSIC_BUFFER_SAMPLES = 2048;
+	/**
+	 * @brief Duration in seconds of the crossfade between two music tracks.
+	 */
+	constexpr double MUSIC_CROSSFADE = 2.0;
+	/**
+	 * @brief Time the audio thread sleeps when it has no command to apply. Finished instances are also returned to their pool at this period.
+	 */
+	constexpr std::chrono::milliseconds AUDIO_PERIOD{2};
 }
 
-SoundCenter::SoundCenter () : update_period{SoundSetting::UPDATE_PERIOD} {}
+/**
+ * @brief Whether an instance has finished playing: it is stopped at position 0 and is not set to loop. A paused instance keeps its position.
+ */
+static bool finished(const ALLEGRO_SAMPLE_INSTANCE *inst) {
+	return !al_get_sample_instance_playing(inst) &&
+		al_get_sample_instance_position(inst) == 0 &&
+		al_get_sample_instance_playmode(inst) != ALLEGRO_PLAYMODE_LOOP;
+}
 
+/**
+ * @details The audio thread is stopped first. The samples whose erase commands it has not applied yet are destroyed with the others.
+ */
 SoundCenter::~SoundCenter() {
-	for(auto &[path, sample_pair] : samples) {
-		auto &[sample, insts] = sample_pair;
-		al_destroy_sample(sample);
-		for(ALLEGRO_SAMPLE_INSTANCE *inst : insts)
-			al_destroy_sample_instance(inst);
+	running = false;
+	if(audio.joinable()) audio.join();
+	Command command;
+	while(commands.pop(command)) {
+		if(command.type == Command::Type::ERASE) destroy(command.sample);
 	}
+	for(auto &[path, sample] : samples) destroy(sample);
+	if(music) al_destroy_audio_stream(music);
+	if(fading) al_destroy_audio_stream(fading);
 }
 
 /**
- * @brief Reserve samples to have default mixer work.
+ * @brief Reserve samples to have default mixer work, and start the audio thread.
  */
 bool
 SoundCenter::init() {
@@ -29,42 +74,222 @@ SoundCenter::init() {
 	res &= al_restore_default_mixer();
 	res &= al_reserve_samples(SoundSetting::RESERVED_SAMPLES);
 	res &= (al_get_default_mixer() != nullptr);
+	if(res && !audio.joinable()) {
+		running = true;
+		audio = std::thread(&SoundCenter::run, this);
+	}
 	return res;
 }
 
 /**
- * @brief The update function searches all sample instances and destroy instances that have finished playing.
+ * @brief Set the gain of the sounds coalesced in this update, count an update, and advance the crossfade of the music. Called once per update.
+ */
+void
+SoundCenter::update() {
+	if(!audio.joinable()) return;
+	for(Sample *sample : coalesced)
+		set_gain(sample->handle, std::min(SoundSetting::MAX_COALESCED_GAIN, std::sqrt(static_cast<float>(sample->plays))));
+	coalesced.clear();
+	++updates;
+	send(Command{Command::Type::UPDATE});
+	if(dropped) {
+		debug_log("<SoundCenter> %zu audio commands dropped, the queue is full.\n", dropped);
+		dropped = 0;
+	}
+}
+
+/**
+ * @brief Queue a command for the audio thread. Never waits.
+ * @return False if the audio thread is not running or the queue is full, in which case the command is dropped.
+ */
+bool
+SoundCenter::send(const Command &command) {
+	if(!audio.joinable()) return false;
+	if(commands.push(command)) return true;
+	++dropped;
+	return false;
+}
+
+/**
+ * @brief Audio thread loop: apply the queued commands, and return the instances played once that have finished to the pool of their sample.
  * @details An instance that has finished playing needs to satisfy all the following conditions:
  * @details * The instance is paused (or stopped).
  * @details * The audio track position is 0 (at initial position).
  * @details * The instance is not set to loop mode.
  */
 void
-SoundCenter::update() {
-	if (update_period == 0) {
-		update_period = SoundSetting::UPDATE_PERIOD;
-		for(auto &[path, audio_pair] : samples) {
-			auto &[sample, insts] = audio_pair;
-			for(auto it = insts.begin(); it != insts.end();) {
-				if(al_get_sample_instance_playing(*it)) ++it;
-				else if(al_get_sample_instance_position(*it) != 0) ++it;
-				else if(al_get_sample_instance_playmode(*it) == ALLEGRO_PLAYMODE_LOOP) ++it;
-				else {
-					al_destroy_sample_instance(*it);
-					it = insts.erase(it);
-				}
-			}
+SoundCenter::run() {
+	// The file interface is per thread, and music streams are opened on this one.
+	SpritePack::get_instance()->use_file_interface();
+	Command command;
+	while(running) {
+		bool idle = true;
+		while(commands.pop(command)) {
+			apply(command);
+			idle = false;
+		}
+		for(size_t i = 0; i < voices.size();) {
+			if(finished(voices[i].inst)) release(i);
+			else ++i;
+		}
+		if(idle) std::this_thread::sleep_for(SoundSetting::AUDIO_PERIOD);
+	}
+}
+
+/**
+ * @brief Apply a command on the audio thread. Commands on a voice that is gone are ignored.
+ */
+void
+SoundCenter::apply(const Command &command) {
+	using Type = Command::Type;
+	if(command.type == Type::LOAD) {
+		Sample &sample = *command.sample;
+		while(static_cast<int>(sample.instances.size()) < SoundSetting::PREALLOCATED_INSTANCES) {
+			ALLEGRO_SAMPLE_INSTANCE *inst = create_instance(sample);
+			if(!inst) break;
+			sample.idle.push_back(inst);
+		}
+		return;
+	}
+	if(command.type == Type::PLAY) {
+		start_voice(*command.sample, command.handle, command.mode, command.priority);
+		applied.store(command.handle, std::memory_order_release);
+		return;
+	}
+	size_t i = find_voice(command.handle);
+	bool found = i < voices.size();
+	switch(command.type) {
+		case Type::STOP: {
+			if(found) release(i);
+			break;
+		} case Type::TOGGLE: {
+			if(!found) break;
+			ALLEGRO_SAMPLE_INSTANCE *inst = voices[i].inst;
+			if(al_get_sample_instance_playing(inst)) {
+				unsigned int pos = al_get_sample_instance_position(inst);
+				al_stop_sample_instance(inst);
+				// As the sample stops, allegro will automatically reset the play position to 0. We need to set it back to be able to resume.
+				al_set_sample_instance_position(inst, pos);
+			} else al_play_sample_instance(inst);
+			break;
+		} case Type::GAIN: {
+			if(found) al_set_sample_instance_gain(voices[i].inst, command.gain);
+			break;
+		} case Type::UPDATE: {
+			fade_music();
+			break;
+		} case Type::ERASE: {
+			destroy(command.sample);
+			break;
+		} case Type::MUSIC: {
+			start_music(command.path, command.updates);
+			break;
+		} case Type::TOGGLE_MUSIC: {
+			if(!music) break;
+			bool playing = !al_get_audio_stream_playing(music);
+			// A stream keeps its position while it is paused, so it resumes where it stopped.
+			al_set_audio_stream_playing(music, playing);
+			if(fading) al_set_audio_stream_playing(fading, playing);
+			break;
+		} case Type::LOAD: case Type::PLAY: {
+			break;
 		}
+	}
+}
+
+/**
+ * @brief Start a voice of a sample on the audio thread, unless the voices are all taken by sounds of a higher priority.
+ */
+void
+SoundCenter::start_voice(Sample &sample, SoundHandle handle, ALLEGRO_PLAYMODE mode, SoundPriority priority) {
+	if(!free_voice(sample, priority)) return;
+	ALLEGRO_SAMPLE_INSTANCE *instance;
+	if(sample.idle.empty()) {
+		instance = create_instance(sample);
+		if(!instance) return;
+		debug_log("<SoundCenter> a sample has %zu instances.\n", sample.instances.size());
 	} else {
-		--update_period;
+		instance = sample.idle.back();
+		sample.idle.pop_back();
+	}
+
+	al_set_sample_instance_playmode(instance, mode);
+	al_set_sample_instance_gain(instance, 1.0f);
+	al_play_sample_instance(instance);
+	voices.push_back(Voice{instance, &sample, handle, mode, priority, serials++});
+	++sample.voices;
+	live[handle % live.size()].store(handle, std::memory_order_release);
+}
+
+/**
+ * @brief Return the instance of a voice to the pool of its sample, stopping it if needed, and remove the voice.
+ */
+void
+SoundCenter::release(size_t i) {
+	Voice &voice = voices[i];
+	if(!finished(voice.inst)) al_stop_sample_instance(voice.inst);
+	voice.sample->idle.push_back(voice.inst);
+	--voice.sample->voices;
+	SoundHandle handle = voice.handle;
+	live[handle % live.size()].compare_exchange_strong(handle, 0);
+	voices[i] = voices.back();
+	voices.pop_back();
+}
+
+/**
+ * @brief Make room for a new voice of a sample, by stopping the oldest voice of the lowest priority if the voices are all taken.
+ * @details If the sample has MAX_VOICES_PER_SAMPLE voices, only its own voices are considered. Voices of a higher priority and looping voices are never stopped.
+ * @return False if there is no room and no voice can be stopped, in which case the new sound is dropped.
+ */
+bool
+SoundCenter::free_voice(const Sample &sample, SoundPriority priority) {
+	bool per_sample = sample.voices >= SoundSetting::MAX_VOICES_PER_SAMPLE;
+	if(!per_sample && voices.size() < static_cast<size_t>(SoundSetting::MAX_VOICES)) return true;
+	size_t victim = voices.size();
+	for(size_t i = 0; i < voices.size(); ++i) {
+		const Voice &voice = voices[i];
+		if(per_sample && voice.sample != &sample) continue;
+		if(voice.mode == ALLEGRO_PLAYMODE_LOOP || voice.priority > priority) continue;
+		if(victim == voices.size() || voice.priority < voices[victim].priority ||
+			(voice.priority == voices[victim].priority && voice.serial < voices[victim].serial))
+			victim = i;
+	}
+	if(victim == voices.size()) return false;
+	release(victim);
+	return true;
+}
+
+/**
+ * @return The index of the voice of a handle, or the number of voices if it is gone.
+ */
+size_t
+SoundCenter::find_voice(SoundHandle handle) const {
+	size_t i = 0;
+	while(i < voices.size() && voices[i].handle != handle) ++i;
+	return i;
+}
+
+/**
+ * @brief Destroy a sample that is no longer in the map, with its voices and instances.
+ */
+void
+SoundCenter::destroy(Sample *sample) {
+	for(size_t i = 0; i < voices.size();) {
+		if(voices[i].sample == sample) release(i);
+		else ++i;
+	}
+	for(ALLEGRO_SAMPLE_INSTANCE *inst : sample->instances) {
+		al_destroy_sample_instance(inst);
 	}
+	al_destroy_sample(sample->sample);
+	delete sample;
 }
 
 /**
  * @brief Remove a sample.
- * @details This function will also destroy all sample instances played by the sample to be destroyed.
+ * @details The sample is removed from the map at once. Its instances and the sample itself are destroyed by the audio thread, after the commands queued before.
  * @param path audio path.
- * @return True if the sample of the path is destroyed. False if the sample does not exist.
+ * @return True if the sample of the path is removed. False if the sample does not exist, or if the command cannot be queued now.
  */
 bool
 SoundCenter::erase_sample(const std::string &path) {
@@ -72,58 +297,218 @@ SoundCenter::erase_sample(const std::string &path) {
 	if(it == samples.end()) {
 		return false;
 	}
-	auto &[sample, insts] = it->second;
-	for(auto inst : insts) {
-		al_destroy_sample_instance(inst);
-	}
-	insts.clear();
-	al_destroy_sample(sample);
+	Command command{Command::Type::ERASE};
+	command.sample = it->second;
+	if(audio.joinable()) {
+		if(!send(command)) return false;
+	} else destroy(it->second);
+	samples.erase(it);
+	MemoryCenter::get_instance()->remove(AssetKind::SOUND, path);
 	return true;
 }
 
 /**
- * @brief Play an audio.
+ * @brief Check if any voice of a sample has not finished playing, as last seen by the audio thread.
+ */
+bool
+SoundCenter::in_use(const std::string &path) {
+	auto it = samples.find(path);
+	if(it == samples.end()) return false;
+	return it->second->voices > 0;
+}
+
+/**
+ * @brief Load a sample without playing it, so that the first play() does not decode it. Its first instances are created by the audio thread.
+ * @details The sample is decoded on the calling thread, since decoding is loading, not playing. Creating instances and attaching them to the mixer takes the locks of the mixer, so it is left to the audio thread.
+ * @details If the sample does not exist, it will immediately call GAME_ASSERT and terminate the game.
  * @param path the audio file path.
- * @param mode the play mode defined by allegro5.
- * @return The curresponding played ALLEGRO_SAMPLE_INSTANCE* instance.
- * @details For the list of supported play modes, refer to [manual](https://liballeg.org/a5docs/trunk/audio.html#allegro_playmode).
+ * @return The loaded sample. In headless mode nothing is loaded and nullptr is returned.
  */
-ALLEGRO_SAMPLE_INSTANCE*
-SoundCenter::play(const string &path, ALLEGRO_PLAYMODE mode) {
+ALLEGRO_SAMPLE*
+SoundCenter::load(const string &path) {
+	if(DataCenter::get_instance()->headless) return nullptr;
 	auto it = samples.find(path);
 	if(it == samples.end()) {
+		double start = StartupProfile::now();
 		ALLEGRO_SAMPLE *sample = al_load_sample(path.c_str());
 		GAME_ASSERT(sample != nullptr, "cannot find sample: %s.", path.c_str());
-		it = samples.insert({path, {sample, {}}}).first;
+		StartupProfile::get_instance()->record("sound", path, StartupProfile::now() - start);
+		Sample *entry = new Sample;
+		entry->sample = sample;
+		Command command{Command::Type::LOAD};
+		command.sample = entry;
+		// If the queue is full, the pool is filled by the first plays instead.
+		send(command);
+		it = samples.insert({path, entry}).first;
+		size_t bytes = al_get_sample_length(sample) * al_get_channel_count(al_get_sample_channels(sample)) *
+			al_get_audio_depth_size(al_get_sample_depth(sample));
+		MemoryCenter::get_instance()->add(AssetKind::SOUND, path, bytes);
+	} else MemoryCenter::get_instance()->touch(AssetKind::SOUND, path);
+	return it->second->sample;
+}
+
+/**
+ * @brief Create an instance of a sample, attached to the default mixer. Audio thread only.
+ * @return The instance, or nullptr if it cannot be created.
+ */
+ALLEGRO_SAMPLE_INSTANCE*
+SoundCenter::create_instance(Sample &sample) {
+	ALLEGRO_SAMPLE_INSTANCE *inst = al_create_sample_instance(sample.sample);
+	if(!inst) return nullptr;
+	if(!al_attach_sample_instance_to_mixer(inst, al_get_default_mixer())) {
+		al_destroy_sample_instance(inst);
+		return nullptr;
 	}
-	auto &[sample, insts] = it->second;
-	ALLEGRO_SAMPLE_INSTANCE *instance = al_create_sample_instance(sample);
-	insts.emplace_back(instance);
+	sample.instances.push_back(inst);
+	return inst;
+}
 
-	al_set_sample_instance_playmode(instance, mode);
-	al_attach_sample_instance_to_mixer(instance, al_get_default_mixer());
-	al_play_sample_instance(instance);
-	return instance;
+/**
+ * @brief Play an audio.
+ * @param path the audio file path.
+ * @param mode the play mode defined by allegro5.
+ * @param priority which voices the sound may replace when the voices are all taken, and which ones may replace it.
+ * @return The handle of the sound. In headless mode, or if the command cannot be queued, nothing is played and 0 is returned.
+ * @details For the list of supported play modes, refer to [manual](https://liballeg.org/a5docs/trunk/audio.html#allegro_playmode).
+ * @details The sample is loaded now if it is not loaded yet. The sound itself is started later by the audio thread, which may also drop it if the voices are all taken.
+ * @details A sample played once that has already been played since the last update() is not played again. Its voice gets louder instead at the next update(), and its handle is returned.
+ */
+SoundHandle
+SoundCenter::play(const string &path, ALLEGRO_PLAYMODE mode, SoundPriority priority) {
+	if(DataCenter::get_instance()->headless) return 0;
+	load(path);
+	Sample &sample = *samples.at(path);
+	if(mode == ALLEGRO_PLAYMODE_ONCE && sample.played == updates) {
+		if(++sample.plays == 2) coalesced.push_back(&sample);
+		return sample.handle;
+	}
+	Command command{Command::Type::PLAY};
+	command.sample = &sample;
+	command.handle = next_handle;
+	command.mode = mode;
+	command.priority = priority;
+	if(!send(command)) return 0;
+	// 0 is never a handle.
+	if(++next_handle == 0) next_handle = 1;
+	if(mode == ALLEGRO_PLAYMODE_ONCE) {
+		sample.played = updates;
+		sample.handle = command.handle;
+		sample.plays = 1;
+	}
+	return command.handle;
 }
 
 /**
- * @brief Check is an instance is currently playing.
+ * @brief Check if a sound has not finished yet. A sound that is queued but not started yet counts as playing, and so does a paused one.
+ * @details A sound older than the 256 latest ones may be reported as finished while it still plays.
  */
 bool
-SoundCenter::is_playing(const ALLEGRO_SAMPLE_INSTANCE *const inst) {
-	return al_get_sample_instance_playing(inst);
+SoundCenter::is_playing(SoundHandle handle) const {
+	if(handle == 0) return false;
+	// Handles grow by one per play, so the difference tells whether the play command has been applied, even across a wrap.
+	if(static_cast<int32_t>(handle - applied.load(std::memory_order_acquire)) > 0) return true;
+	return live[handle % live.size()].load(std::memory_order_acquire) == handle;
 }
 
 /**
- * @brief Pause or play an audio, depends on its current playing state.
+ * @brief Pause or play a sound, depends on its current playing state.
  */
 void
-SoundCenter::toggle_playing(ALLEGRO_SAMPLE_INSTANCE *inst) {
-	bool is_playing = al_get_sample_instance_playing(inst);
-	if(is_playing) {
-		unsigned int pos = al_get_sample_instance_position(inst);
-		al_stop_sample_instance(inst);
-		// As the sample stops, allegro will automatically reset the play position to 0. We need to set it back to be able to resume.
-		al_set_sample_instance_position(inst, pos);
-	} else al_play_sample_instance(inst);
+SoundCenter::toggle_playing(SoundHandle handle) {
+	if(handle == 0) return;
+	Command command{Command::Type::TOGGLE};
+	command.handle = handle;
+	send(command);
+}
+
+/**
+ * @brief Stop a sound, and return its instance to the pool.
+ */
+void
+SoundCenter::stop(SoundHandle handle) {
+	if(handle == 0) return;
+	Command command{Command::Type::STOP};
+	command.handle = handle;
+	send(command);
+}
+
+void
+SoundCenter::set_gain(SoundHandle handle, float gain) {
+	if(handle == 0) return;
+	Command command{Command::Type::GAIN};
+	command.handle = handle;
+	command.gain = gain;
+	send(command);
+}
+
+/**
+ * @brief Stream a music track in a loop, replacing the current one.
+ * @details The file is decoded while it plays, so only the buffers of the stream are in memory. If a track is already playing, the new one crossfades with it over SoundSetting::MUSIC_CROSSFADE seconds of updates. The crossfade only advances in update(), so it waits while the game is paused.
+ * @param path the audio file path.
+ * @return True if the track is queued or is already the current one. In headless mode, or if the command cannot be queued, nothing is played and false is returned.
+ */
+bool
+SoundCenter::play_music(const std::string &path) {
+	if(DataCenter::get_instance()->headless) return false;
+	if(path == music_path) return true;
+	Command command{Command::Type::MUSIC};
+	GAME_ASSERT(path.size() < sizeof(command.path), "music path too long: %s.", path.c_str());
+	path.copy(command.path, path.size());
+	command.updates = std::max(1, static_cast<int>(SoundSetting::MUSIC_CROSSFADE * DataCenter::get_instance()->FPS));
+	if(!send(command)) return false;
+	music_path = path;
+	music_playing = true;
+	return true;
+}
+
+/**
+ * @brief Open the stream of a music track on the audio thread, and start the crossfade with the current one.
+ * @details If the stream cannot be opened, it will immediately call GAME_ASSERT and terminate the game.
+ */
+void
+SoundCenter::start_music(const std::string &path, int crossfade) {
+	double start = StartupProfile::now();
+	ALLEGRO_AUDIO_STREAM *stream = al_load_audio_stream(path.c_str(), SoundSetting::MUSIC_BUFFER_COUNT, SoundSetting::MUSIC_BUFFER_SAMPLES);
+	GAME_ASSERT(stream != nullptr, "cannot find music: %s.", path.c_str());
+	StartupProfile::get_instance()->record("music", path, StartupProfile::now() - start);
+	al_set_audio_stream_playmode(stream, ALLEGRO_PLAYMODE_LOOP);
+	if(fading) al_destroy_audio_stream(fading);
+	fading = music;
+	if(fading) {
+		fading_gain = al_get_audio_stream_gain(fading);
+		fade_updates = 0;
+		fade_length = crossfade;
+		al_set_audio_stream_gain(stream, 0);
+	}
+	al_attach_audio_stream_to_mixer(stream, al_get_default_mixer());
+	music = stream;
+}
+
+/**
+ * @brief Advance the crossfade of the music by one update, on the audio thread.
+ */
+void
+SoundCenter::fade_music() {
+	if(!fading) return;
+	float t = std::min(1.0f, static_cast<float>(++fade_updates) / fade_length);
+	al_set_audio_stream_gain(music, t);
+	al_set_audio_stream_gain(fading, fading_gain * (1 - t));
+	if(t >= 1) {
+		al_destroy_audio_stream(fading);
+		fading = nullptr;
+	}
+}
+
+/**
+ * @brief Pause or resume the music, depends on its current playing state, like toggle_playing(). A track that is fading out is paused and resumed with it.
+ */
+void
+SoundCenter::toggle_music() {
+	if(music_path.empty()) return;
+	if(send(Command{Command::Type::TOGGLE_MUSIC})) music_playing = !music_playing;
+}
+
+bool
+SoundCenter::is_music_playing() const {
+	return music_playing;
 }
@@ -2,15 +2,38 @@
 #define SOUNDCENTER_H_INCLUDED
 
 #include <map>
-#include <utility>
+#include <array>
+#include <atomic>
+#include <thread>
 #include <string>
 #include <vector>
+#include <cstdint>
 #include <allegro5/allegro_audio.h>
+#include "RingBuffer.h"
+
+/**
+ * @brief Priority of a played sound. When the voices are all taken, a new sound replaces a voice of lower or equal priority, or is dropped.
+ */
+enum class SoundPriority {
+	LOW,
+	NORMAL,
+	HIGH
+};
+
+/**
+ * @brief Identifies a sound started by SoundCenter::play(). 0 means no sound.
+ */
+typedef uint32_t SoundHandle;
 
 /**
  * @brief Stores and manages audio samples and instances.
  * @details All data related to basic allegro audio (ALLEGRO_SAMPLE and ALLEGRO_SAMPLE_INSTANCE) are all managed by SoundCenter.
- * If any sample instance has finished playing, the sample instance will be destroyed via update function.
+ * Playing, stopping, pausing and changing the gain of a sound only queue a command and never wait, so the game never waits on the locks of the mixer. An audio thread applies the commands in order, and is the only thread that creates instances and attaches them to the mixer. Samples are still decoded by the caller.
+ * Every sample keeps a pool of instances attached to the default mixer. Playing a sample takes an idle instance from the pool, so playing a sample again allocates nothing once the pool has grown to the number of its voices playing at once.
+ * Instances played once return to the pool as soon as the audio thread sees them finished. Only the instances that are playing are checked, not every sample.
+ * The number of voices playing at once is bounded, in total and per sample, so the mixing cost does not grow with the number of towers that fire. Plays of the same sample within one update share a single voice.
+ * Music is not loaded as a sample. It is streamed from its file through a few small buffers by an ALLEGRO_AUDIO_STREAM, and a new track crossfades with the previous one.
+ * @details Apart from the audio thread, only used on the main thread.
  */
 class SoundCenter
 {
@@ -23,21 +46,136 @@ public:
 	bool init();
 	void update();
 	bool erase_sample(const std::string &path);
-	ALLEGRO_SAMPLE_INSTANCE *play(const std::string &path, ALLEGRO_PLAYMODE mode);
-	bool is_playing(const ALLEGRO_SAMPLE_INSTANCE *const inst);
-	void toggle_playing(ALLEGRO_SAMPLE_INSTANCE *inst);
+	bool in_use(const std::string &path);
+	ALLEGRO_SAMPLE *load(const std::string &path);
+	SoundHandle play(const std::string &path, ALLEGRO_PLAYMODE mode, SoundPriority priority = SoundPriority::NORMAL);
+	bool is_playing(SoundHandle handle) const;
+	void toggle_playing(SoundHandle handle);
+	void stop(SoundHandle handle);
+	void set_gain(SoundHandle handle, float gain);
+	bool play_music(const std::string &path);
+	void toggle_music();
+	bool is_music_playing() const;
+private:
+	SoundCenter() {}
+	/**
+	 * @brief A loaded sample and the pool of its instances.
+	 * @details Created by load() on the main thread. Once it has been sent to the audio thread, only the audio thread touches its pool, and the audio thread deletes it when it is erased.
+	 */
+	struct Sample {
+		ALLEGRO_SAMPLE *sample;
+		/**
+		 * @brief Every instance of the sample, idle or not.
+		 */
+		std::vector<ALLEGRO_SAMPLE_INSTANCE*> instances;
+		/**
+		 * @brief Instances that are stopped at the start of the sample and ready to be played.
+		 */
+		std::vector<ALLEGRO_SAMPLE_INSTANCE*> idle;
+		/**
+		 * @brief Number of voices of the sample. Written by the audio thread, and read by in_use().
+		 */
+		std::atomic<int> voices{0};
+		/**
+		 * @brief Value of `updates` when the sample was last played once, the handle of that play, and the number of plays coalesced into it. Main thread only.
+		 */
+		unsigned long long played = ~0ULL;
+		SoundHandle handle = 0;
+		int plays = 0;
+	};
+	/**
+	 * @brief An instance that has not been seen finished yet. Audio thread only.
+	 */
+	struct Voice {
+		ALLEGRO_SAMPLE_INSTANCE *inst;
+		Sample *sample;
+		SoundHandle handle;
+		ALLEGRO_PLAYMODE mode;
+		SoundPriority priority;
+		/**
+		 * @brief Order in which the voices started, to find the oldest one.
+		 */
+		unsigned long long serial;
+	};
+	/**
+	 * @brief A command sent to the audio thread. Only the fields used by its type are set.
+	 * @details Trivially copyable, so that queueing it never allocates.
+	 */
+	struct Command {
+		enum class Type {
+			LOAD,
+			PLAY,
+			STOP,
+			TOGGLE,
+			GAIN,
+			UPDATE,
+			ERASE,
+			MUSIC,
+			TOGGLE_MUSIC
+		};
+		Type type;
+		Sample *sample;
+		SoundHandle handle;
+		ALLEGRO_PLAYMODE mode;
+		SoundPriority priority;
+		float gain;
+		/**
+		 * @brief Path of the music track, and the length of its crossfade in updates.
+		 */
+		char path[128];
+		int updates;
+	};
+	bool send(const Command &command);
+	void run();
+	void apply(const Command &command);
+	ALLEGRO_SAMPLE_INSTANCE *create_instance(Sample &sample);
+	void start_voice(Sample &sample, SoundHandle handle, ALLEGRO_PLAYMODE mode, SoundPriority priority);
+	bool free_voice(const Sample &sample, SoundPriority priority);
+	void release(size_t i);
+	size_t find_voice(SoundHandle handle) const;
+	void destroy(Sample *sample);
+	void start_music(const std::string &path, int crossfade);
+	void fade_music();
 private:
-	SoundCenter();
 	/**
 	 * @brief This map container stores all audio data managed by SoundCenter.
-	 * @details Key object of the map is audio path, and the respective value objects are ALLEGRO_SAMPLE* and a list of ALLEGRO_SAMPLE_INSTANCE*. The ALLEGRO_SAMPLE* represents the corresponding audio sample, and the list of ALLEGRO_SAMPLE_INSTANCE* represent all playing samples.
-	 * Once the sample (ALLEGRO_SAMPLE*) is created, the sample will not be destroyed until the game process ends.
+	 * @details Key object of the map is audio path, and the respective value object is the sample and its instances.
+	 * Once the sample (ALLEGRO_SAMPLE*) is created, the sample is kept until MemoryCenter evicts it, which only happens while none of its instances is playing.
+	 */
+	std::map<std::string, Sample*> samples;
+	/**
+	 * @brief Main thread state: updates counted so far, the next handle, the samples played more than once in this update, the current music track, and the commands dropped because the queue was full.
+	 */
+	unsigned long long updates = 0;
+	SoundHandle next_handle = 1;
+	std::vector<Sample*> coalesced;
+	std::string music_path;
+	bool music_playing = false;
+	size_t dropped = 0;
+	/**
+	 * @brief Commands from the main thread to the audio thread.
+	 */
+	RingBuffer<Command, 256> commands;
+	std::thread audio;
+	std::atomic<bool> running{false};
+	/**
+	 * @brief State published by the audio thread for is_playing(): the handle of the last play command applied, and the handles of the voices by handle modulo the table size.
+	 */
+	std::atomic<SoundHandle> applied{0};
+	std::array<std::atomic<SoundHandle>, 256> live{};
+	/**
+	 * @brief Audio thread state: voices that have not been seen finished yet, including looping and paused ones.
 	 */
-	std::map<std::string, std::pair<ALLEGRO_SAMPLE*, std::vector<ALLEGRO_SAMPLE_INSTANCE*>>> samples;
+	std::vector<Voice> voices;
+	unsigned long long serials = 0;
 	/**
-	 * @brief Sound update period.
+	 * @brief Audio thread state: stream of the current music track, and stream of the previous track while it fades out, with its gain when the crossfade started, the updates the crossfade has run and its length in updates.
 	 */
-	int update_period;
+	ALLEGRO_AUDIO_STREAM *music = nullptr;
+	ALLEGRO_AUDIO_STREAM *fading = nullptr;
+	float fading_gain = 0;
+	int fade_updates = 0;
+	int fade_length = 1;
 };
 
 #endif
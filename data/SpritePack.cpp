@@ -0,0 +1,508 @@
+#include "SpritePack.h"
+#include <allegro5/allegro.h>
+#include <allegro5/allegro_image.h>
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <set>
+#include <string_view>
+#include <utility>
+#include <vector>
+#include "../Utils.h"
+#include "AtlasCenter.h"
+#include "GIFRecord.h"
+
+/*
+ * Pack layout. All offsets are from the start of the file, and every record
+ * starts on a 16-byte boundary, so the records can be read in place from the
+ * mapping.
+ *
+ *   PackHeader
+ *   for every asset:   GIFRecord
+ *                   or PackImage, width * height ABGR pixels
+ *                   or the bytes of the file
+ *   path strings
+ *   SpritePack::Entry[entry_count], sorted by path
+ */
+namespace {
+	constexpr char pack_magic[8] = {'S', 'P', 'R', 'P', 'A', 'C', 'K', '\0'};
+	constexpr uint32_t pack_version = 3;
+	constexpr uint32_t KIND_GIF = 1, KIND_IMAGE = 2, KIND_FILE = 3;
+	constexpr size_t record_align = 16;
+
+	struct PackHeader {
+		char magic[8];
+		uint32_t version;
+		uint32_t entry_count;
+		uint64_t index_offset;
+		uint64_t strings_offset;
+		uint64_t strings_size;
+	};
+	struct PackImage {
+		int32_t width, height;
+		uint64_t pixels_offset;
+	};
+
+	/**
+	 * @brief Size and modification time of a source file, to tell whether it changed since the pack was built.
+	 * @return False if the file does not exist.
+	 */
+	bool source_stamp(const std::string &path, uint64_t &size, int64_t &mtime) {
+		ALLEGRO_FS_ENTRY *entry = al_create_fs_entry(path.c_str());
+		bool exists = entry && al_fs_entry_exists(entry);
+		if(exists) {
+			size = static_cast<uint64_t>(al_get_fs_entry_size(entry));
+			mtime = static_cast<int64_t>(al_get_fs_entry_mtime(entry));
+		}
+		if(entry) al_destroy_fs_entry(entry);
+		return exists;
+	}
+
+	/**
+	 * @brief Key of an asset path: forward slashes and no leading "./", so that "./assets/a.gif" and "assets\a.gif" match.
+	 */
+	std::string pack_key(const std::string &path) {
+		std::string key = path;
+		std::replace(key.begin(), key.end(), '\\', '/');
+		while(key.compare(0, 2, "./") == 0) key.erase(0, 2);
+		return key;
+	}
+
+	bool has_extension(const std::string &path, std::initializer_list<const char*> extensions) {
+		size_t dot = path.find_last_of('.');
+		if(dot == std::string::npos) return false;
+		std::string ext = path.substr(dot);
+		for(char &c : ext) c = static_cast<char>(tolower(static_cast<unsigned char>(c)));
+		for(const char *e : extensions)
+			if(ext == e) return true;
+		return false;
+	}
+
+	void collect_files(ALLEGRO_FS_ENTRY *dir, std::vector<std::string> &paths) {
+		if(!al_open_directory(dir)) return;
+		while(ALLEGRO_FS_ENTRY *entry = al_read_directory(dir)) {
+			if(al_get_fs_entry_mode(entry) & ALLEGRO_FILEMODE_ISDIR) collect_files(entry, paths);
+			else paths.emplace_back(al_get_fs_entry_name(entry));
+			al_destroy_fs_entry(entry);
+		}
+		al_close_directory(dir);
+	}
+
+	std::vector<std::string> list_files(const char *root) {
+		std::vector<std::string> paths;
+		ALLEGRO_FS_ENTRY *dir = al_create_fs_entry(root);
+		collect_files(dir, paths);
+		al_destroy_fs_entry(dir);
+		std::sort(paths.begin(), paths.end());
+		return paths;
+	}
+
+	/**
+	 * @brief Sequential writer that keeps track of the file offset.
+	 */
+	struct PackWriter {
+		ALLEGRO_FILE *file;
+		uint64_t offset = 0;
+		bool ok = true;
+		void write(const void *data, size_t size) {
+			if(size && al_fwrite(file, data, size) != size) ok = false;
+			offset += size;
+		}
+		void align() {
+			static const uint8_t zeros[record_align] = {};
+			write(zeros, (record_align - offset % record_align) % record_align);
+		}
+	};
+
+	bool write_gif(PackWriter &writer, const std::string &path) {
+		ALGIF_ANIMATION *gif = algif_load_raw(al_fopen(path.c_str(), "rb"));
+		if(!gif) return false;
+		std::vector<uint8_t> record;
+		GIFRecord::write(record, gif);
+		algif_destroy_animation(gif);
+		writer.write(record.data(), record.size());
+		return true;
+	}
+
+	bool write_image(PackWriter &writer, const std::string &path) {
+		ALLEGRO_BITMAP *bitmap = al_load_bitmap(path.c_str());
+		if(!bitmap) return false;
+		ALLEGRO_LOCKED_REGION *lr = al_lock_bitmap(bitmap, ALLEGRO_PIXEL_FORMAT_ABGR_8888, ALLEGRO_LOCK_READONLY);
+		if(!lr) {
+			al_destroy_bitmap(bitmap);
+			return false;
+		}
+		PackImage header{};
+		header.width = al_get_bitmap_width(bitmap);
+		header.height = al_get_bitmap_height(bitmap);
+		header.pixels_offset = writer.offset + sizeof(header);
+		writer.write(&header, sizeof(header));
+		for(int y = 0; y < header.height; ++y)
+			writer.write(static_cast<const uint8_t*>(lr->data) + static_cast<ptrdiff_t>(y) * lr->pitch, sizeof(uint32_t) * header.width);
+		al_unlock_bitmap(bitmap);
+		al_destroy_bitmap(bitmap);
+		return true;
+	}
+
+	bool write_file(PackWriter &writer, const std::string &path) {
+		ALLEGRO_FILE *file = al_fopen(path.c_str(), "rb");
+		if(!file) return false;
+		uint8_t buffer[1 << 16];
+		while(size_t n = al_fread(file, buffer, sizeof(buffer)))
+			writer.write(buffer, n);
+		bool ok = !al_ferror(file);
+		al_fclose(file);
+		return ok;
+	}
+
+	/*
+	 * File interface that reads raw assets from the mapping. Other paths, and
+	 * every path opened for writing, are opened with the interface that was in
+	 * use when the pack was opened.
+	 */
+	const ALLEGRO_FILE_INTERFACE *fallback_interface = nullptr;
+
+	struct PackFile {
+		const uint8_t *data;
+		int64_t size, pos;
+		bool eof;
+		ALLEGRO_FILE *fallback;
+	};
+
+	PackFile *pack_file(ALLEGRO_FILE *f) {
+		return static_cast<PackFile*>(al_get_file_userdata(f));
+	}
+
+	void *pack_fopen(const char *path, const char *mode) {
+		size_t size = 0;
+		const uint8_t *data = strpbrk(mode, "wa+") ? nullptr : SpritePack::get_instance()->load_file(path, size);
+		if(data) return new PackFile{data, static_cast<int64_t>(size), 0, false, nullptr};
+		ALLEGRO_FILE *fallback = al_fopen_interface(fallback_interface, path, mode);
+		if(!fallback) return nullptr;
+		return new PackFile{nullptr, 0, 0, false, fallback};
+	}
+
+	bool pack_fclose(ALLEGRO_FILE *f) {
+		PackFile *pf = pack_file(f);
+		bool ok = pf->fallback ? al_fclose(pf->fallback) : true;
+		delete pf;
+		return ok;
+	}
+
+	size_t pack_fread(ALLEGRO_FILE *f, void *ptr, size_t size) {
+		PackFile *pf = pack_file(f);
+		if(pf->fallback) return al_fread(pf->fallback, ptr, size);
+		size_t n = pf->pos < pf->size ? std::min(size, static_cast<size_t>(pf->size - pf->pos)) : 0;
+		if(n) memcpy(ptr, pf->data + pf->pos, n);
+		pf->pos += n;
+		if(n < size) pf->eof = true;
+		return n;
+	}
+
+	size_t pack_fwrite(ALLEGRO_FILE *f, const void *ptr, size_t size) {
+		PackFile *pf = pack_file(f);
+		return pf->fallback ? al_fwrite(pf->fallback, ptr, size) : 0;
+	}
+
+	bool pack_fflush(ALLEGRO_FILE *f) {
+		PackFile *pf = pack_file(f);
+		return pf->fallback ? al_fflush(pf->fallback) : true;
+	}
+
+	int64_t pack_ftell(ALLEGRO_FILE *f) {
+		PackFile *pf = pack_file(f);
+		return pf->fallback ? al_ftell(pf->fallback) : pf->pos;
+	}
+
+	bool pack_fseek(ALLEGRO_FILE *f, int64_t offset, int whence) {
+		PackFile *pf = pack_file(f);
+		if(pf->fallback) return al_fseek(pf->fallback, offset, whence);
+		int64_t base = whence == ALLEGRO_SEEK_CUR ? pf->pos : whence == ALLEGRO_SEEK_END ? pf->size : 0;
+		if(base + offset < 0) return false;
+		pf->pos = base + offset;
+		pf->eof = false;
+		return true;
+	}
+
+	bool pack_feof(ALLEGRO_FILE *f) {
+		PackFile *pf = pack_file(f);
+		return pf->fallback ? al_feof(pf->fallback) : pf->eof;
+	}
+
+	int pack_ferror(ALLEGRO_FILE *f) {
+		PackFile *pf = pack_file(f);
+		return pf->fallback ? al_ferror(pf->fallback) : 0;
+	}
+
+	const char *pack_ferrmsg(ALLEGRO_FILE *f) {
+		PackFile *pf = pack_file(f);
+		return pf->fallback ? al_ferrmsg(pf->fallback) : "";
+	}
+
+	void pack_fclearerr(ALLEGRO_FILE *f) {
+		PackFile *pf = pack_file(f);
+		if(pf->fallback) al_fclearerr(pf->fallback);
+		else pf->eof = false;
+	}
+
+	int pack_fungetc(ALLEGRO_FILE *f, int c) {
+		PackFile *pf = pack_file(f);
+		if(pf->fallback) return al_fungetc(pf->fallback, c);
+		// The mapping is read-only, so only the byte that was just read can be pushed back.
+		if(pf->pos <= 0 || pf->pos > pf->size || pf->data[pf->pos - 1] != static_cast<uint8_t>(c)) return EOF;
+		--pf->pos;
+		pf->eof = false;
+		return c;
+	}
+
+	off_t pack_fsize(ALLEGRO_FILE *f) {
+		PackFile *pf = pack_file(f);
+		return pf->fallback ? al_fsize(pf->fallback) : static_cast<off_t>(pf->size);
+	}
+
+	const ALLEGRO_FILE_INTERFACE pack_file_interface = {
+		pack_fopen, pack_fclose, pack_fread, pack_fwrite, pack_fflush, pack_ftell, pack_fseek,
+		pack_feof, pack_ferror, pack_ferrmsg, pack_fclearerr, pack_fungetc, pack_fsize
+	};
+};
+
+struct SpritePack::Entry {
+	uint32_t path_offset;
+	uint32_t path_length;
+	uint32_t kind;
+	uint32_t reserved;
+	uint64_t data_offset;
+	uint64_t data_size;
+	/**
+	 * @brief Size and modification time of the source file when the pack was built.
+	 */
+	uint64_t source_size;
+	int64_t source_mtime;
+};
+
+/**
+ * @brief Build the pack from the asset folders. This is the `--compile-assets` run mode.
+ * @details Images are decoded by the Allegro image addon as memory bitmaps, so no display is needed.
+ * @return Process exit code.
+ */
+int
+SpritePack::compile(const char *pack_path) {
+	GAME_ASSERT(al_init(), "failed to initialize allegro.");
+	GAME_ASSERT(al_init_image_addon(), "failed to initialize allegro image addon.");
+	al_set_new_bitmap_flags(ALLEGRO_MEMORY_BITMAP);
+
+	ALLEGRO_FILE *file = al_fopen(pack_path, "wb");
+	if(!file) {
+		fprintf(stderr, "cannot write %s.\n", pack_path);
+		return 1;
+	}
+	PackWriter writer{file};
+	PackHeader header{};
+	writer.write(&header, sizeof(header));
+
+	std::vector<std::pair<std::string, Entry>> index;
+	int gifs = 0, images = 0, files = 0, failed = 0;
+	auto add = [&](const std::string &path, uint32_t kind) {
+		writer.align();
+		Entry entry{};
+		entry.kind = kind;
+		entry.data_offset = writer.offset;
+		bool ok = source_stamp(path, entry.source_size, entry.source_mtime) && (kind == KIND_GIF ? write_gif(writer, path) : kind == KIND_IMAGE ? write_image(writer, path) : write_file(writer, path));
+		if(!ok) {
+			fprintf(stderr, "skip %s: cannot read.\n", path.c_str());
+			++failed;
+			return;
+		}
+		entry.data_size = writer.offset - entry.data_offset;
+		index.emplace_back(pack_key(path), entry);
+		++(kind == KIND_GIF ? gifs : kind == KIND_IMAGE ? images : files);
+	};
+	for(const std::string &path : list_files(SpritePackSetting::gif_root))
+		if(has_extension(path, {".gif"})) add(path, KIND_GIF);
+	for(const std::string &path : list_files(SpritePackSetting::image_root))
+		if(has_extension(path, {".png", ".jpg", ".jpeg", ".bmp"})) add(path, KIND_IMAGE);
+	// Everything else is stored as it is, e.g. fonts, sounds and levels.
+	std::set<std::string> packed;
+	for(const auto &[key, entry] : index) packed.insert(key);
+	packed.insert(pack_key(pack_path));
+	for(const std::string &path : list_files(SpritePackSetting::asset_root))
+		if(!packed.count(pack_key(path))) add(path, KIND_FILE);
+
+	std::sort(index.begin(), index.end(), [](const auto &a, const auto &b) { return a.first < b.first; });
+	writer.align();
+	header.strings_offset = writer.offset;
+	for(auto &[key, entry] : index) {
+		entry.path_offset = static_cast<uint32_t>(writer.offset - header.strings_offset);
+		entry.path_length = static_cast<uint32_t>(key.size());
+		writer.write(key.data(), key.size());
+	}
+	header.strings_size = writer.offset - header.strings_offset;
+	writer.align();
+	header.index_offset = writer.offset;
+	for(auto &[key, entry] : index)
+		writer.write(&entry, sizeof(entry));
+	uint64_t total = writer.offset;
+
+	memcpy(header.magic, pack_magic, sizeof(header.magic));
+	header.version = pack_version;
+	header.entry_count = static_cast<uint32_t>(index.size());
+	al_fseek(file, 0, ALLEGRO_SEEK_SET);
+	writer.write(&header, sizeof(header));
+	writer.ok &= al_fclose(file);
+	if(!writer.ok) {
+		fprintf(stderr, "failed to write %s.\n", pack_path);
+		return 1;
+	}
+	printf("%s: %d GIFs, %d images, %d other files, %.1f MB (%d skipped).\n", pack_path, gifs, images, files, total / 1e6, failed);
+	return 0;
+}
+
+/**
+ * @brief Map the pack and check its header. Lookups fail if the pack cannot be opened.
+ * @return True if the pack is usable.
+ */
+bool
+SpritePack::open(const char *pack_path) {
+	entries = nullptr;
+	entry_count = 0;
+	strings = nullptr;
+	stale.clear();
+	if(!enabled) {
+		debug_log("<SpritePack> disabled, assets are decoded from their files.\n");
+		return false;
+	}
+	if(!file.open(pack_path)) {
+		debug_log("<SpritePack> %s not found, assets are decoded from their files.\n", pack_path);
+		return false;
+	}
+	const PackHeader *header = reinterpret_cast<const PackHeader*>(file.data());
+	if(file.size() < sizeof(PackHeader) || memcmp(header->magic, pack_magic, sizeof(pack_magic)) != 0 ||
+		header->version != pack_version ||
+		!in_range(header->index_offset, static_cast<uint64_t>(header->entry_count) * sizeof(Entry)) ||
+		!in_range(header->strings_offset, header->strings_size)) {
+		debug_log("<SpritePack> %s is not a valid sprite pack.\n", pack_path);
+		file.close();
+		return false;
+	}
+	entries = reinterpret_cast<const Entry*>(file.data() + header->index_offset);
+	entry_count = header->entry_count;
+	strings = reinterpret_cast<const char*>(file.data() + header->strings_offset);
+	debug_log("<SpritePack> %s mapped with %u assets.\n", pack_path, entry_count);
+#ifdef DEBUG
+	check_sources();
+#endif
+	if(al_get_new_file_interface() != &pack_file_interface)
+		fallback_interface = al_get_new_file_interface();
+	use_file_interface();
+	return true;
+}
+
+/**
+ * @brief Make al_fopen, and every al_load_* function that uses it, read the raw assets of the pack on the calling thread.
+ * @details The file interface of Allegro is per thread, so every thread that loads assets has to call this. open() calls it for its own thread.
+ */
+void
+SpritePack::use_file_interface() const {
+	if(entries) al_set_new_file_interface(&pack_file_interface);
+}
+
+bool
+SpritePack::in_range(uint64_t offset, uint64_t size) const {
+	return offset <= file.size() && size <= file.size() - offset;
+}
+
+const SpritePack::Entry*
+SpritePack::find(const std::string &path, uint32_t kind) const {
+	if(!entries) return nullptr;
+	std::string key = pack_key(path);
+	auto name = [this](const Entry &e) { return std::string_view(strings + e.path_offset, e.path_length); };
+	const Entry *it = std::lower_bound(entries, entries + entry_count, key,
+		[&name](const Entry &e, const std::string &k) { return name(e) < k; });
+	if(it == entries + entry_count || name(*it) != key || it->kind != kind) return nullptr;
+	if(!in_range(it->data_offset, it->data_size)) return nullptr;
+	if(!stale.empty() && stale[it - entries]) return nullptr;
+	return it;
+}
+
+/**
+ * @brief Compare every entry with its source file, once. A source file that changed after the pack was built is loaded from the file instead. A missing one is served from the pack.
+ */
+void
+SpritePack::check_sources() {
+	stale.assign(entry_count, false);
+	size_t changed = 0;
+	for(uint32_t i = 0; i < entry_count; ++i) {
+		std::string path{strings + entries[i].path_offset, entries[i].path_length};
+		uint64_t size = 0;
+		int64_t mtime = 0;
+		if(source_stamp(path, size, mtime) && (size != entries[i].source_size || mtime != entries[i].source_mtime)) {
+			debug_log("<SpritePack> %s changed since the pack was built, loaded from its file.\n", path.c_str());
+			stale[i] = true;
+			++changed;
+		}
+	}
+	if(changed) debug_log("<SpritePack> %zu assets changed, rebuild the pack with make pack.\n", changed);
+}
+
+/**
+ * @brief Bytes of a raw asset, e.g. a font, a sound or a level. They point into the mapping. Safe to call from any thread.
+ * @return The bytes, or nullptr if the file is not in the pack.
+ */
+const uint8_t*
+SpritePack::load_file(const std::string &path, size_t &size) const {
+	const Entry *entry = find(path, KIND_FILE);
+	if(!entry) return nullptr;
+	size = static_cast<size_t>(entry->data_size);
+	return file.data() + entry->data_offset;
+}
+
+/**
+ * @brief Create the animation of a packed GIF. The frame indices point into the mapping, so nothing is decoded.
+ * @details The frames still have to be composed, e.g. with algif_compose_animation. Safe to call from any thread.
+ * @return The animation, or nullptr if the GIF is not in the pack.
+ */
+ALGIF_ANIMATION*
+SpritePack::load_gif(const std::string &path) const {
+	const Entry *entry = find(path, KIND_GIF);
+	if(!entry) return nullptr;
+	return GIFRecord::read(file.data() + entry->data_offset, entry->data_size, true);
+}
+
+/**
+ * @brief Create the bitmap of a packed image by copying its pixels from the mapping. Small images are placed in the atlas.
+ * @details Must run on the main thread, since it creates a bitmap.
+ * @param lod level of detail: the image is downscaled by 2^lod with a box filter, see algif_downscale.
+ * @return The bitmap, or nullptr if the image is not in the pack.
+ */
+ALLEGRO_BITMAP*
+SpritePack::load_image(const std::string &path, int lod) const {
+	const Entry *entry = find(path, KIND_IMAGE);
+	if(!entry || entry->data_size < sizeof(PackImage)) return nullptr;
+	const PackImage *header = reinterpret_cast<const PackImage*>(file.data() + entry->data_offset);
+	if(header->width <= 0 || header->height <= 0 ||
+		!in_range(header->pixels_offset, sizeof(uint32_t) * static_cast<uint64_t>(header->width) * header->height))
+		return nullptr;
+	const uint32_t *pixels = reinterpret_cast<const uint32_t*>(file.data() + header->pixels_offset);
+	if(lod == 0) return AtlasCenter::get_instance()->upload(pixels, header->width, header->height);
+	std::vector<uint32_t> scaled(pixels, pixels + static_cast<size_t>(header->width) * header->height);
+	algif_downscale(scaled.data(), header->width, header->height, 1, lod);
+	return AtlasCenter::get_instance()->upload(scaled.data(), algif_lod_size(header->width, lod), algif_lod_size(header->height, lod));
+}
+
+/**
+ * @brief Size of a packed image, read from its header. No pixel is touched. Safe to call from any thread.
+ * @return False if the image is not in the pack.
+ */
+bool
+SpritePack::image_size(const std::string &path, int &width, int &height) const {
+	const Entry *entry = find(path, KIND_IMAGE);
+	if(!entry || entry->data_size < sizeof(PackImage)) return false;
+	const PackImage *header = reinterpret_cast<const PackImage*>(file.data() + entry->data_offset);
+	if(header->width <= 0 || header->height <= 0) return false;
+	width = header->width;
+	height = header->height;
+	return true;
+}
+
@@ -0,0 +1,66 @@
+#ifndef SPRITEPACK_H_INCLUDED
+#define SPRITEPACK_H_INCLUDED
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <allegro5/bitmap.h>
+#include "MappedFile.h"
+#include "../algif5/algif.h"
+
+// fixed settings
+namespace SpritePackSetting {
+	constexpr char path[] = "./assets/sprites.pack";
+	constexpr char gif_root[] = "./assets/gif";
+	constexpr char image_root[] = "./assets/image";
+	constexpr char asset_root[] = "./assets";
+};
+
+/**
+ * @brief Every asset, compiled offline into one file that is memory mapped at runtime.
+ * @details The pack is built by `game --compile-assets` (or `make pack`) from every file under SpritePackSetting::asset_root. It should be rebuilt when an asset changes.
+ * @details GIFs under SpritePackSetting::gif_root are stored as decoded frames (palette and indices), so loading one only composes the frames from the mapping. Images under SpritePackSetting::image_root are stored as RGBA pixels and uploaded straight from the mapping. Other files, e.g. fonts, sounds and levels, are stored as they are and read through a file interface, so al_fopen and the al_load_* functions open no file for them.
+ * @details Assets are looked up by path. A missing pack or a path that is not in it makes the caller fall back to the original file.
+ * @details Every entry records the size and the modification time of its source file. In debug builds, open() compares them with the files once, and an asset whose file differs is not served from the pack: an edited GIF goes through GIFCache and an edited image or file is read from disk until the pack is rebuilt.
+ * Release builds trust the pack and touch no source file, so a release build must be packed again after an asset is edited.
+ */
+class SpritePack
+{
+public:
+	static SpritePack *get_instance() {
+		static SpritePack SP;
+		return &SP;
+	}
+	static int compile(const char *pack_path);
+	bool open(const char *pack_path);
+	void set_enabled(bool enabled) { this->enabled = enabled; }
+	ALGIF_ANIMATION *load_gif(const std::string &path) const;
+	ALLEGRO_BITMAP *load_image(const std::string &path, int lod) const;
+	bool image_size(const std::string &path, int &width, int &height) const;
+	const uint8_t *load_file(const std::string &path, size_t &size) const;
+	void use_file_interface() const;
+private:
+	SpritePack() {}
+	struct Entry;
+	const Entry *find(const std::string &path, uint32_t kind) const;
+	bool in_range(uint64_t offset, uint64_t size) const;
+	void check_sources();
+private:
+	MappedFile file;
+	/**
+	 * @brief Index of the pack, sorted by path. Points into the mapping.
+	 */
+	const Entry *entries = nullptr;
+	uint32_t entry_count = 0;
+	const char *strings = nullptr;
+	/**
+	 * @brief Whether the source file of each entry changed since the pack was built. Empty if it was not checked.
+	 */
+	std::vector<bool> stale;
+	/**
+	 * @brief If false, open() maps nothing and every asset is loaded from its file.
+	 */
+	bool enabled = true;
+};
+
+#endif
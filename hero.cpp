@@ -4,6 +4,7 @@
  #include "algif5/algif.h"
  #include "shapes/Rectangle.h"
  #include "data/ImageCenter.h"
+ #include "data/LOD.h"
 
 //read gif file
 
@@ -12,12 +13,14 @@ void Hero::init(int y)
     ImageCenter *IC = ImageCenter::get_instance();
     char buffer[50];
     sprintf(buffer, "assets/image/weeder.png");
-    ALLEGRO_BITMAP *bitmap = IC->get(buffer);
+    IC->get(buffer);
 	const double &cx = 220;
 	const double &cy = y;
 	// We set the hit box slightly smaller than the actual bounding box of the image because there are mostly empty spaces near the edge of a image.
-	const int &h = al_get_bitmap_width(bitmap) * 0.8;
-	const int &w = al_get_bitmap_height(bitmap) * 0.8;
+	// The size of the image file is used, so that the hit box does not depend on the level of detail of the bitmap.
+	std::pair<int, int> size = IC->get_size(buffer);
+	const int &h = size.first * 0.8;
+	const int &w = size.second * 0.8;
 	shape.reset(new Rectangle{
 		(cx - w / 2.), (cy - h / 2.),
 		(cx - w / 2. + w), (cy - h / 2. + h)
@@ -27,19 +30,22 @@ void Hero::init(int y)
 void Hero::draw()
 {   //load gif
    ImageCenter *IC = ImageCenter::get_instance();
+   DataCenter *DC = DataCenter::get_instance();
 	char buffer[50];
     sprintf(buffer, "assets/image/weeder.png");
 	ALLEGRO_BITMAP *bitmap = IC->get(buffer);
-	al_draw_bitmap(
+	LOD::draw(
 		bitmap,
-		shape->center_x() - al_get_bitmap_width(bitmap) / 2,
-		shape->center_y() - al_get_bitmap_height(bitmap) / 2, 0);
+		draw_x(DC->render_alpha) - LOD::width(bitmap) / 2,
+		draw_y(DC->render_alpha) - LOD::height(bitmap) / 2, 0);
 }
 
 void Hero::update()
 {
+    DataCenter *DC = DataCenter::get_instance();
+    save_prev_center();
     if(state == HeroState::GO)
-        shape->update_center_x(shape->center_x() + speed);
+        shape->update_center_x(shape->center_x() + speed / DC->FPS);
 }
 
 
@@ -18,7 +18,7 @@ public:
     void draw();
     HeroState state = HeroState::STOP;
 private:
-    double speed = 5;
+    double speed = 300; // px/s
 };
 
 #endif
\ No newline at end of file
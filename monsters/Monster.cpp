@@ -4,20 +4,24 @@
 #include "MonsterWolfKnight.h"
 #include "MonsterDemonNinja.h"
 #include "../data/DataCenter.h"
+#include "../data/LOD.h"
 #include "../data/ImageCenter.h"
 #include "../Level.h"
 #include "../shapes/Point.h"
 #include "../shapes/Rectangle.h"
 #include "../Utils.h"
 #include <allegro5/allegro_primitives.h>
+#include <algorithm>
+#include <allegro5/allegro.h>
 #include "../data/GIFCenter.h"
+#include "../data/MemoryCenter.h"
  #include "../algif5/algif.h"
 
 using namespace std;
 
 // fixed settings
 enum class Dir {
-	ORI, EAT, FALL, NOHEAD, ANGRY, ANGRY_EAT, LOSEPAPER, ASH,
+	ORI, EAT, FALL, NOHEAD, ANGRY, ANGRY_EAT, LOSEPAPER, ASH, DIR_MAX
 };
 namespace MonsterSetting {
 	/*revise
@@ -41,34 +45,96 @@ namespace MonsterSetting {
 		"original", "eat", "fall", "nohead", "angry", "angry_eat", "losepaper", "ash", 
 	};
 	//revise end
+	constexpr char gif_path_format[] = "%s/%s.gif";
+	//! @brief Monster GIFs play slower than their encoded frame durations.
+	constexpr double animation_speed = 0.6;
 }
 
 /**
- * @brief Create a Monster* instance by the type.
+ * @brief Animation of each (MonsterType, Dir) state, or nullptr if the monster has no GIF for that state.
+ * @see Monster::load_animations()
+ */
+static ALGIF_ANIMATION *animations[static_cast<int>(MonsterType::MONSTERTYPE_MAX)][static_cast<int>(Dir::DIR_MAX)];
+static bool animations_loaded = false;
+
+static std::string animation_path(int type, int dir) {
+	char buffer[50];
+	sprintf(buffer, MonsterSetting::gif_path_format, MonsterSetting::gif_root_path[type], MonsterSetting::gif_postfix[dir]);
+	return buffer;
+}
+
+/**
+ * @brief Paths of the GIFs of all monster states that have one, for GIFCenter::preload.
+ */
+std::vector<std::string>
+Monster::animation_paths() {
+	std::vector<std::string> paths;
+	for(int t = 0; t < static_cast<int>(MonsterType::MONSTERTYPE_MAX); ++t) {
+		for(int d = 0; d < static_cast<int>(Dir::DIR_MAX); ++d) {
+			std::string path = animation_path(t, d);
+			if(al_filename_exists(path.c_str())) paths.emplace_back(std::move(path));
+		}
+	}
+	return paths;
+}
+
+/**
+ * @brief Resolve the GIF of every (MonsterType, Dir) state once, so that monsters only swap animation pointers when their state changes.
+ * @details Called when a level is loaded. Further calls do nothing. The GIFs are preloaded first, so the ones that are not loaded yet are decoded in parallel.
+ * @details The table is kept for the whole game, so its GIFs are pinned in MemoryCenter for good.
+ * @see Level::load_level(int lvl)
+ */
+void
+Monster::load_animations() {
+	if(animations_loaded) return;
+	GIFCenter *GIFC = GIFCenter::get_instance();
+	std::vector<std::string> paths = animation_paths();
+	for(const std::string &path : paths)
+		MemoryCenter::get_instance()->pin(AssetKind::GIF, path);
+	GIFC->preload(paths);
+	for(int t = 0; t < static_cast<int>(MonsterType::MONSTERTYPE_MAX); ++t) {
+		for(int d = 0; d < static_cast<int>(Dir::DIR_MAX); ++d) {
+			std::string path = animation_path(t, d);
+			animations[t][d] = al_filename_exists(path.c_str()) ? GIFC->get(path) : nullptr;
+		}
+	}
+	animations_loaded = true;
+}
+
+/**
+ * @brief Create a monster of the type in DataCenter::monsters.
  * @param type the type of a monster.
  * @param path walk path of the monster. The path should be represented in road grid format.
- * @return The curresponding Monster* instance.
+ * @return Handle of the new monster.
  * @see Level::grid_to_region(const Point &grid) const
  */
-Monster *Monster::create_monster(MonsterType type, const vector<Point> &path) {
+ObjectPool<Monster>::Handle Monster::create_monster(MonsterType type, const vector<Point> &path) {
+	ObjectPool<Monster> &monsters = DataCenter::get_instance()->monsters;
 	switch(type) {
 		case MonsterType::WOLF: {
-			return new MonsterWolf{path};
+			return monsters.emplace<MonsterWolf>(path);
 		}
 		case MonsterType::CAVEMAN: {
-			return new MonsterCaveMan{path};
+			return monsters.emplace<MonsterCaveMan>(path);
 		}
 		case MonsterType::WOLFKNIGHT: {
-			return new MonsterWolfKnight{path};
+			return monsters.emplace<MonsterWolfKnight>(path);
 		}
 		case MonsterType::DEMONNIJIA: {
-			return new MonsterDemonNinja{path};
+			return monsters.emplace<MonsterDemonNinja>(path);
 		}
 		case MonsterType::MONSTERTYPE_MAX: {}
 	}
 	GAME_ASSERT(false, "monster type error.");
 }
 
+/**
+ * @brief Size of the largest monster class, which is the slot size of DataCenter::monsters.
+ */
+size_t Monster::pool_slot_size() {
+	return max({sizeof(MonsterWolf), sizeof(MonsterCaveMan), sizeof(MonsterWolfKnight), sizeof(MonsterDemonNinja)});
+}
+
 /**
  * @brief Given velocity of x and y direction, determine which direction the monster should face.
  */
@@ -79,9 +145,8 @@ Monster::Monster(const vector<Point> &path, MonsterType type) {
 	dead = false;
 	shape.reset(new Rectangle{0, 0, 0, 0});
 	this->type = type;
-	dir = Dir::ORI;
-	bitmap_img_id = 0;
-	bitmap_switch_counter = 0;
+	gif = nullptr;
+	set_dir(Dir::ORI);
 	for(const Point &p : path)
 		this->path.push(p);
 	if(!path.empty()) {
@@ -95,18 +160,13 @@ Monster::Monster(const vector<Point> &path, MonsterType type) {
 
 /**
  * @details This update function updates the following things in order:
- * @details * Move pose of the current facing direction (bitmap_img_id).
+ * @details * Frame of the current animation.
  * @details * Current position (center of the hit box). The position is moved based on the center of the hit box (Rectangle). If the center of this monster reaches the center of the first point of path, the function will proceed to the next point of path.
  * @details * Update the real bounding box by the center of the hit box calculated as above.
  */
 void
 Monster::update() {
-
-	char buffer[50];
-    sprintf(buffer, "%s/%s.gif",
-            MonsterSetting::gif_root_path[static_cast<int>(type)],
-            MonsterSetting::gif_postfix[static_cast<int>(dir)]); //print to buffer array
-    gifPath[static_cast<int>(type)] = std::string(buffer);
+	save_prev_center();
 
 	DataCenter *DC = DataCenter::get_instance();
 	//revise
@@ -119,57 +179,22 @@ Monster::update() {
         }
     }
 
-	// After a period, the bitmap for this monster should switch from (i)-th image to (i+1)-th image to represent animation.
-	if(bitmap_switch_counter) --bitmap_switch_counter;
-	else {
-		bitmap_img_id = (bitmap_img_id + 1) % (bitmap_img_ids[static_cast<int>(dir)].size());
-		bitmap_switch_counter = bitmap_switch_freq;
-	}
-	
-	GIFCenter *GIFC = GIFCenter::get_instance();
-    ALGIF_ANIMATION *gif = GIFC->get(gifPath[static_cast<int>(type)]);
-    if (gif) {
-        // 獲取當前幀的持續時間（以毫秒為單位）
-        int frame_duration = gif->frames[current_frame].duration;
-
-        // 遞增幀計時器
-        frame_timer += 100 / DataCenter::get_instance()->FPS; // 每幀時間（毫秒）
-
-        // 如果超過幀持續時間，切換到下一幀
-        if (frame_timer >= frame_duration) {
-            frame_timer = 0;
-            current_frame = (current_frame + 1) % gif->frames_count;
-        }
-    }
+	// Advance the frame of the current animation.
+	algif_cursor_advance(&cursor, gif, MonsterSetting::animation_speed / DC->FPS);
 
 	if(type== MonsterType::CAVEMAN){
 		if(HP<90){
-			type = MonsterType::WOLF;
-			char buffer[50];
-			sprintf(buffer, "%s/%s.gif",
-					MonsterSetting::gif_root_path[static_cast<int>(type)],
-					MonsterSetting::gif_postfix[static_cast<int>(dir)]);
-			gifPath[static_cast<int>(type)] = std::string(buffer);
+			set_type(MonsterType::WOLF);
 		}
 	}
 	else if(type == MonsterType::WOLFKNIGHT){
 		if(HP<90 && HP>0){
 			v = 35;
 			if(dir == Dir::ORI){
-				char buffer[50];
-				dir = Dir:: ANGRY;
-				sprintf(buffer, "%s/%s.gif",
-						MonsterSetting::gif_root_path[static_cast<int>(type)],
-						MonsterSetting::gif_postfix[static_cast<int>(dir)]);
-				gifPath[static_cast<int>(type)] = std::string(buffer);
+				set_dir(Dir::ANGRY);
 			}
 			else if(dir == Dir::EAT){
-				char buffer[50];
-				dir = Dir:: ANGRY_EAT;
-				sprintf(buffer, "%s/%s.gif",
-						MonsterSetting::gif_root_path[static_cast<int>(type)],
-						MonsterSetting::gif_postfix[static_cast<int>(dir)]);
-				gifPath[static_cast<int>(type)] = std::string(buffer);
+				set_dir(Dir::ANGRY_EAT);
 			}
 		}
 	}
@@ -213,31 +238,31 @@ Monster::update() {
 
 void
 Monster::draw() {
-	GIFCenter *GIFC = GIFCenter::get_instance();
-    ALGIF_ANIMATION *gif = GIFC->get(gifPath[static_cast<int>(type)]);
-	if (!gif) {
-        debug_log("GIF : %s\n", gifPath[static_cast<int>(type)].c_str());
-        return;
-    }
+	DataCenter *DC = DataCenter::get_instance();
 	// 獲取當前幀位圖
-    ALLEGRO_BITMAP *frame_bitmap = algif_get_frame_bitmap(gif, current_frame);
+    ALLEGRO_BITMAP *frame_bitmap = algif_cursor_bitmap(&cursor, gif);
     if (!frame_bitmap) {
-        debug_log(" GIF: %s\n", gifPath[static_cast<int>(type)].c_str());
         return;
     }
+	// The blender cannot change while drawing is held, so a hit monster breaks the batch.
+	bool held = is_hit && al_is_bitmap_drawing_held();
+	if (held) al_hold_bitmap_drawing(false);
 	if (is_hit) {
         al_set_blender(ALLEGRO_ADD, ALLEGRO_ONE, ALLEGRO_ONE); // 增加亮度
     }
 
     // 繪製當前幀
-    al_draw_bitmap(
+    LOD::draw(
         frame_bitmap,
-        shape->center_x() - gif->width / 2,
-        shape->center_y() - gif->height / 2,
+        draw_x(DC->render_alpha) - gif->width / 2,
+        draw_y(DC->render_alpha) - gif->height / 2,
         0);
 
-    // 恢復默認混合模式
-    al_set_blender(ALLEGRO_ADD, ALLEGRO_ALPHA, ALLEGRO_INVERSE_ALPHA);
+    if (is_hit) {
+        // 恢復默認混合模式
+        al_set_blender(ALLEGRO_ADD, ALLEGRO_ALPHA, ALLEGRO_INVERSE_ALPHA);
+    }
+    if (held) al_hold_bitmap_drawing(true);
     //draw gif
     /*algif_draw_gif(gif,
                     shape->center_x() - gif->width/2,
@@ -264,39 +289,67 @@ void Monster::eating() {
 	is_eating = true;
 	*/
 	is_eating = true;
-	dir = Dir::EAT;
+	if(dir == Dir::ANGRY || dir == Dir::ANGRY_EAT)
+		set_dir(Dir::ANGRY_EAT);
+	else
+		set_dir(Dir::EAT);
 }
 
 void Monster::resume() {
     is_eating = false;
 	if(dir==Dir::ANGRY_EAT){
-		dir = Dir::ANGRY;
+		set_dir(Dir::ANGRY);
 	}
 	else{
-		dir = Dir::ORI;
+		set_dir(Dir::ORI);
 	}
-	char buffer[50];
-	sprintf(buffer, "%s/%s.gif",
-			MonsterSetting::gif_root_path[static_cast<int>(type)],
-			MonsterSetting::gif_postfix[static_cast<int>(dir)]);
-	gifPath[static_cast<int>(type)] = std::string(buffer);
 }
 
 void Monster::die(int x) {
 		if(!dead){
 			if(x)
-				dir = Dir::FALL;
+				set_dir(Dir::FALL);
 			else
-				dir = Dir::ASH;
-		char buffer[50];
-		sprintf(buffer, "%s/%s.gif",
-			MonsterSetting::gif_root_path[static_cast<int>(type)],
-			MonsterSetting::gif_postfix[static_cast<int>(dir)]);
-			gifPath[static_cast<int>(type)] = std::string(buffer);
+				set_dir(Dir::ASH);
 		}
 		dead = true;
 }
 
+/**
+ * @brief Change the facing direction (animation state) and swap to its animation.
+ */
+void
+Monster::set_dir(Dir dir) {
+	this->dir = dir;
+	ALGIF_ANIMATION *next = animations[static_cast<int>(type)][static_cast<int>(dir)];
+	GAME_ASSERT(next != nullptr, "monster type %d has no animation for state %s.",
+		static_cast<int>(type), MonsterSetting::gif_postfix[static_cast<int>(dir)]);
+	if(next != gif) {
+		gif = next;
+		algif_cursor_reset(&cursor);
+	}
+}
+
+/**
+ * @brief Change the monster type, keeping the current direction, and swap to its animation.
+ */
+void
+Monster::set_type(MonsterType type) {
+	this->type = type;
+	set_dir(dir);
+}
+
+/**
+ * @brief Counts down the death animation by one tick.
+ */
+void
+Monster::update_death_timer() {
+	DataCenter *DC = DataCenter::get_instance();
+	if(death_timer >= 0) {
+		death_timer -= 1.0 / DC->FPS;
+	}
+}
+
 Rectangle
 Monster::get_region() const {
 	return {
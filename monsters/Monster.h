@@ -3,9 +3,11 @@
 
 #include "../Object.h"
 #include "../shapes/Rectangle.h"
+#include "../data/ObjectPool.h"
 #include <vector>
 #include <queue>
-#include <map>
+#include <string>
+#include "../algif5/algif.h"
 
 enum class Dir;
 
@@ -21,26 +23,22 @@ enum class MonsterType {
 class Monster : public Object
 {
 public:
-	static Monster *create_monster(MonsterType type, const std::vector<Point> &path);
+	static ObjectPool<Monster>::Handle create_monster(MonsterType type, const std::vector<Point> &path);
+	static size_t pool_slot_size();
+	static std::vector<std::string> animation_paths();
+	static void load_animations();
 public:
 	Monster(const std::vector<Point> &path, MonsterType type);
 	void update();
 	void draw();
 	void eating();
 	void resume();
-	int current_frame = 0;     // 當前幀索引
-    int frame_timer = 0;       // 計算幀時間
 	float death_timer = 1.4f; // -1 表示未死亡状态
     void die(int x);
     bool is_dead() const {
         return death_timer <= 0.0f;
     }
-    void update_death_timer() {
-		float delta_time = 0.016f;
-        if (death_timer >= 0) {
-            death_timer -= delta_time;
-        }
-    }
+    void update_death_timer();
 	const int &get_money() const { return money; }
 	int HP;
 	const std::queue<Point> &get_path() const { return path; }
@@ -61,21 +59,6 @@ protected:
 	 * @var money
 	 * @brief The amount of money that player will earn when the monster is killed.
 	 **
-	 * @var bitmap_img_ids
-	 * @brief The first vector is the Dir index, and the second vector is image id.
-	 * @details `bitmap_img_ids[Dir][<ordered_id>]`
-	 **
-	 * @var bitmap_switch_counter
-	 * @brief Counting down for bitmap_switch_freq.
-	 * @see Monster::bitmap_switch_freq
-	 **
-	 * @var bitmap_switch_freq
-	 * @brief Number of frames required to change to the next move pose for the current facing direction.
-	 * @details The variable is left for child classes to define.
-	 * 
-	 * @var bitmap_img_id
-	 * @brief Move pose of the current facing direction.
-	 **
 	 * @var dir
 	 * @brief Current facing direction.
 	 **
@@ -85,15 +68,21 @@ protected:
 	*/
 	int v;
 	int money;
-	std::vector<std::vector<int>> bitmap_img_ids;
-	int bitmap_switch_counter;
-	int bitmap_switch_freq;
-	int bitmap_img_id;
 	//revise start
-	std::map<int, std::string> gifPath; // 每種怪物類型對應的 GIF 路徑
 	bool is_eating; 
 	//revise end
+	void set_dir(Dir dir);
+	void set_type(MonsterType type);
 private:
+	/**
+	 * @brief Animation of the current (type, dir) state.
+	 * @see Monster::load_animations()
+	 */
+	ALGIF_ANIMATION *gif;
+	/**
+	 * @brief Playback position in the current animation. Restarted whenever the animation changes.
+	 */
+	ALGIF_CURSOR cursor;
 	MonsterType type;
 	//Dir dir;
 	std::queue<Point> path;
@@ -11,11 +11,6 @@ public:
 		HP = 120;
 		v = 20;
 		money = 20;
-		bitmap_img_ids.emplace_back(std::vector<int>({0, 1, 2, 3})); // UP
-		bitmap_img_ids.emplace_back(std::vector<int>({0, 1, 2, 3})); // DOWN
-		bitmap_img_ids.emplace_back(std::vector<int>({0, 1, 2, 3})); // LEFT
-		bitmap_img_ids.emplace_back(std::vector<int>({0, 1, 2, 3})); // RIGHT
-		bitmap_switch_freq = 20;
 	}
 };
 
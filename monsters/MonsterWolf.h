@@ -11,11 +11,6 @@ public:
 		HP = 60;
 		v = 20;
 		money = 10;
-		bitmap_img_ids.emplace_back(std::vector<int>({0, 1, 2, 3})); // UP
-		bitmap_img_ids.emplace_back(std::vector<int>({0, 1, 2, 3})); // DOWN
-		bitmap_img_ids.emplace_back(std::vector<int>({0, 1, 2, 3, 4})); // LEFT
-		bitmap_img_ids.emplace_back(std::vector<int>({0, 1, 2, 3, 4})); // RIGHT
-		bitmap_switch_freq = 20;
 	}
 };
 
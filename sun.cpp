@@ -1,6 +1,8 @@
 #include "sun.h"
 #include "data/DataCenter.h"
+#include "data/LOD.h"
 #include "data/GIFCenter.h"
+#include "data/MemoryCenter.h"
 #include "algif5/algif.h"
 #include "shapes/Circle.h"
 #include "shapes/Point.h"
@@ -8,26 +10,39 @@
 #include "data/ImageCenter.h"
 
 Sun::Sun(const Point &p, const std::string &path, double init_vx, double init_vy, double gravity, double stop_height)
-: vx(init_vx), vy(init_vy), gravity(gravity), stop_height(stop_height)
+: gif_path(&path), vx(init_vx), vy(init_vy), gravity(gravity), stop_height(stop_height)
 {
     GIFCenter *GIFC = GIFCenter::get_instance();
+    MemoryCenter::get_instance()->pin(AssetKind::GIF, path);
 	gif = GIFC->get(path);  // 從 GIFCenter 獲取 GIF 動畫
-    gif_time = 0;           // 初始化 GIF 動畫時間 
+    algif_cursor_reset(&cursor); // 初始化 GIF 動畫播放位置
 
     // 設定子彈的碰撞體形狀
-    double r = std::min(gif->width,gif->height) * 0.8;
-    shape.reset(new Circle{p.x, p.y, r});
+    // gif may be a placeholder until it is loaded, so the size is taken from the GIF header.
+    std::pair<int, int> size = GIFC->get_size(path);
+    r = std::min(size.first, size.second) * 0.8;
+    circle = Circle{p.x, p.y, r};
+    shape = std::shared_ptr<Shape>(std::shared_ptr<Shape>(), &circle);
 };
 
+Sun::~Sun()
+{
+    MemoryCenter::get_instance()->unpin(AssetKind::GIF, *gif_path);
+}
+
 void Sun::update()
 {
+    DataCenter *DC = DataCenter::get_instance();
+    save_prev_center();
+    // 更新 GIF 動畫播放位置
+    algif_cursor_advance(&cursor, gif, 1.0 / DC->FPS);
     // 只有当投射物高于停止高度时才继续移动
-    if (shape->center_y() + vy < stop_height) {
-        shape->update_center_x(shape->center_x() + vx);
-        shape->update_center_y(shape->center_y() + vy);
+    if (shape->center_y() + vy / DC->FPS < stop_height) {
+        shape->update_center_x(shape->center_x() + vx / DC->FPS);
+        shape->update_center_y(shape->center_y() + vy / DC->FPS);
 
         // 应用重力加速度，使垂直速度逐渐增加（向下加速）
-        vy += gravity;
+        vy += gravity / DC->FPS;
     } else {
         // 如果到达停止高度，停止移动
         vy = 0;
@@ -38,18 +53,17 @@ void Sun::update()
 void Sun::draw()
 {
     DataCenter *DC = DataCenter::get_instance();
-	ALLEGRO_BITMAP *current_frame = algif_get_bitmap(gif, gif_time);
+	GIFCenter::get_instance()->resolve(gif, *gif_path);
+	ALLEGRO_BITMAP *current_frame = algif_cursor_bitmap(&cursor, gif);
 	if (current_frame) {
-		al_draw_bitmap(
+		LOD::draw(
 			current_frame,
-			shape->center_x() - al_get_bitmap_width(current_frame) / 2,
-			shape->center_y() - al_get_bitmap_height(current_frame) / 2,
+			draw_x(DC->render_alpha) - LOD::width(current_frame) / 2,
+			draw_y(DC->render_alpha) - LOD::height(current_frame) / 2,
 			0);
 	}
-	// 更新 GIF 動畫時間
-	gif_time += 1.0 / DC->FPS;
 };
 
 Circle Sun::get_region() const {
-        return *shape;
+        return Circle{shape->center_x(), shape->center_y(), r};
     }
\ No newline at end of file
@@ -10,18 +10,22 @@ class Sun : public Object
 {
 public :
     Sun(const Point &p, const std::string &path, double init_vx, double init_vy, double gravity, double stop_height);
+    Sun(const Sun&) = delete;
+    ~Sun();
     void update();
     void draw();
     Circle get_region() const;
 private :
+    double r;                         // 碰撞半徑
     ALGIF_ANIMATION *gif;  // 使用 ALGIF_ANIMATION 代替 ALLEGRO_BITMAP
-    double gif_time;       // 追踪 GIF 動畫播放的時間
-    double vx;                        
-    double vy;                       
-    double gravity;                   // 重力加速度
+    const std::string *gif_path;      // gif 的路徑，陽光存在期間在 MemoryCenter 中 pin 住；指向呼叫者的字串，必須比陽光活得久
+    ALGIF_CURSOR cursor;   // 此陽光自己的 GIF 播放位置
+    double vx;                        // 水平速度 (px/s)
+    double vy;                        // 垂直速度 (px/s)
+    double gravity;                   // 重力加速度 (px/s^2)
     double stop_height;               // 停止下落的高度
     int width, height;
-    std::shared_ptr<Circle> shape;  // 形狀，這裡使用 shared_ptr 管理 Circle 物件
+    Circle circle;                    // 碰撞體本身，shape 指向它而不擁有它，建立時不需配置記憶體
 };
 
 
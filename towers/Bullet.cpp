@@ -1,11 +1,13 @@
 #include "Bullet.h"
 #include "../data/DataCenter.h"
+#include "../data/LOD.h"
 #include "../data/ImageCenter.h"
 #include "../shapes/Circle.h"
 #include "../shapes/Point.h"
 #include <algorithm>
 #include <allegro5/bitmap_draw.h>
 #include "../data/GIFCenter.h"
+#include "../data/MemoryCenter.h"
 #include "../algif5/algif.h"
 
 /*Bullet::Bullet(const Point &p, const Point &target, const std::string &path, double v, int dmg, double fly_dist) {
@@ -19,24 +21,32 @@
 	vx = (target.x - p.x) * v / d;
 	vy = (target.y - p.y) * v / d;
 }*/
-Bullet::Bullet(const Point &p, const std::string &path, double v, int dmg, double fly_dist) {
+Bullet::Bullet(const Point &p, const std::string &path, double v, int dmg, double fly_dist) : gif_path(&path) {
     GIFCenter *GIFC = GIFCenter::get_instance();
+	MemoryCenter::get_instance()->pin(AssetKind::GIF, path);
 	gif = GIFC->get(path);  // 從 GIFCenter 獲取 GIF 動畫
-    gif_time = 0;           // 初始化 GIF 動畫時間 
+    algif_cursor_reset(&cursor); // 初始化 GIF 動畫播放位置
     //ImageCenter *IC = ImageCenter::get_instance();
     this->fly_dist = /*fly_dist*/1500;
     this->dmg = dmg;
     //bitmap = IC->get(path);
 
     // 設定子彈的碰撞體形狀
-    double r = std::min(gif->width,gif->height) * 0.8;
-    shape.reset(new Circle{p.x, p.y, r});
+    // gif may be a placeholder until it is loaded, so the size is taken from the GIF header.
+    std::pair<int, int> size = GIFC->get_size(path);
+    double r = std::min(size.first, size.second) * 0.8;
+    circle = Circle{p.x, p.y, r};
+    shape = std::shared_ptr<Shape>(std::shared_ptr<Shape>(), &circle);
 
     // 固定向右飛行的速度
     vx = v;   // 水平速度向右
     vy = 0;   // 垂直速度為 0
 }
 
+Bullet::~Bullet() {
+	MemoryCenter::get_instance()->unpin(AssetKind::GIF, *gif_path);
+}
+
 /**
  * @brief Update the bullet position by its velocity and fly_dist by its movement per frame.
  * @details We don't detect whether to delete the bullet itself here because deleting a object itself doesn't make any sense.
@@ -59,9 +69,12 @@ Bullet::update() {
 	}
 }*/
 void Bullet::update() {
+    DataCenter *DC = DataCenter::get_instance();
+    save_prev_center();
+    // 更新 GIF 動畫播放位置
+    algif_cursor_advance(&cursor, gif, 1.0 / DC->FPS);
     if (fly_dist == 0) return;
 
-    DataCenter *DC = DataCenter::get_instance();
     double dx = vx / DC->FPS;
     shape->update_center_x(shape->center_x() + dx);
     fly_dist -= std::abs(dx);
@@ -80,14 +93,13 @@ Bullet::draw() {
 		shape->center_x() - al_get_bitmap_width(bitmap) / 2,
 		shape->center_y() - al_get_bitmap_height(bitmap) / 2, 0);*/
 	DataCenter *DC = DataCenter::get_instance();
-	ALLEGRO_BITMAP *current_frame = algif_get_bitmap(gif, gif_time);
+	GIFCenter::get_instance()->resolve(gif, *gif_path);
+	ALLEGRO_BITMAP *current_frame = algif_cursor_bitmap(&cursor, gif);
 	if (current_frame) {
-		al_draw_bitmap(
+		LOD::draw(
 			current_frame,
-			shape->center_x() - al_get_bitmap_width(current_frame) / 2,
-			shape->center_y() - al_get_bitmap_height(current_frame) / 2,
+			draw_x(DC->render_alpha) - LOD::width(current_frame) / 2,
+			draw_y(DC->render_alpha) - LOD::height(current_frame) / 2,
 			0);
 	}
-	// 更新 GIF 動畫時間
-	gif_time += 1.0 / DC->FPS;
 }
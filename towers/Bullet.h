@@ -5,6 +5,7 @@
 #include <allegro5/bitmap.h>
 #include <string>
 #include "../algif5/algif.h"
+#include "../shapes/Circle.h"
 
 /**
  * @brief The bullet shot from Tower.
@@ -15,6 +16,8 @@ class Bullet : public Object
 public:
 	//Bullet(const Point &p, const Point &target, const std::string &path, double v, int dmg, double fly_dist);
 	Bullet(const Point &p, const std::string &path, double v, int dmg, double fly_dist);
+	Bullet(const Bullet&) = delete;
+	~Bullet();
 	void update();
 	void draw();
 	const double &get_fly_dist() const { return fly_dist; }
@@ -41,7 +44,15 @@ private:
 	 */
 	//ALLEGRO_BITMAP *bitmap;
 	ALGIF_ANIMATION *gif;  // 使用 ALGIF_ANIMATION 代替 ALLEGRO_BITMAP
-    double gif_time;       // 追踪 GIF 動畫播放的時間
+	/**
+	 * @brief Path of gif, pinned in MemoryCenter while the bullet exists. Points to the caller's string, which must outlive the bullet (e.g. an entry of TowerSetting::tower_bullet_img_path), so creating a bullet does not copy it.
+	 */
+	const std::string *gif_path;
+    ALGIF_CURSOR cursor;   // 此子彈自己的 GIF 播放位置
+	/**
+	 * @brief Storage of the hit box. Object::shape points here without owning it, so creating a bullet does not allocate.
+	 */
+	Circle circle;
 };
 
 #endif
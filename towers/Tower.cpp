@@ -9,10 +9,15 @@
 #include "../monsters/Monster.h"
 #include "../shapes/Rectangle.h"
 #include "../data/DataCenter.h"
+#include "../data/LOD.h"
 #include "../data/ImageCenter.h"
 #include "../data/SoundCenter.h"
 #include <allegro5/bitmap_draw.h>
+#include <algorithm>
+#include <cmath>
 #include "../data/GIFCenter.h"
+#include <tuple>
+#include "../data/MemoryCenter.h"
 #include "../algif5/algif.h"
 
 // fixed settings
@@ -52,13 +57,42 @@ Tower::create_tower(TowerType type, const Point &p) {
 	GAME_ASSERT(false, "tower type error.");
 }
 
+ObjectPool<Tower>::Handle
+Tower::plant_tower(TowerType type, const Point &p) {
+	ObjectPool<Tower> &towers = DataCenter::get_instance()->towers;
+	ObjectPool<Tower>::Handle h;
+	switch(type) {
+		case TowerType::ARCANE: {
+			h = towers.emplace<TowerArcane>(p); break;
+		} case TowerType::ARCHER: {
+			h = towers.emplace<TowerArcher>(p); break;
+		} case TowerType::CANON: {
+			h = towers.emplace<TowerCanon>(p); break;
+		} case TowerType::POISON: {
+			h = towers.emplace<TowerPoison>(p); break;
+		} case TowerType::STORM: {
+			h = towers.emplace<TowerStorm>(p); break;
+		} case TowerType::TOWERTYPE_MAX: {
+			GAME_ASSERT(false, "tower type error.");
+		}
+	}
+	towers.get(h)->planted = true;
+	return h;
+}
+
+size_t
+Tower::pool_slot_size() {
+	return std::max({sizeof(TowerArcane), sizeof(TowerArcher), sizeof(TowerCanon), sizeof(TowerPoison), sizeof(TowerStorm)});
+}
+
 /**
  * @param p center point (x, y).
  * @param attack_range any monster inside this number would trigger attack.
- * @param attack_freq period for tower to attack.
+ * @param attack_period period (in seconds) for tower to attack.
  * @param type tower type.
 */
-Tower::Tower(const Point &p, double attack_range, int attack_freq, TowerType type, int h) {
+Tower::Tower(const Point &p, double attack_range, double attack_period, TowerType type, int h) {
+	DataCenter *DC = DataCenter::get_instance();
 	//revise start
 	//ImageCenter *IC = ImageCenter::get_instance();
 	GIFCenter *GIFC = GIFCenter::get_instance();
@@ -66,14 +100,24 @@ Tower::Tower(const Point &p, double attack_range, int attack_freq, TowerType typ
 	// shape here is used to represent the tower's defending region. If any monster walks into this area (i.e. the bounding box of the monster and defending region of the tower has overlap), the tower should attack.
 	shape.reset(new Circle(p.x, p.y, attack_range));
 	counter = 0;
-	this->attack_freq = attack_freq;
+	// Rounded to the nearest tick, so that the period does not get shorter at tick rates it is not a multiple of.
+	this->attack_freq = std::max(1, static_cast<int>(std::lround(attack_period * DC->FPS)));
 	this->type = type;
 	//revise
+	// The animation is kept until the tower is destroyed.
+	MemoryCenter::get_instance()->pin(AssetKind::GIF, TowerSetting::tower_gif_path[static_cast<int>(type)]);
 	animation = GIFC->get(TowerSetting::tower_gif_path[static_cast<int>(type)]);
+	// The animation may be a placeholder until it is loaded, so the size is taken from the GIF header.
+	std::tie(width, height) = GIFC->get_size(TowerSetting::tower_gif_path[static_cast<int>(type)]);
+	algif_cursor_reset(&cursor);
 	hp = h;
 	planted = false;
 }
 
+Tower::~Tower() {
+	MemoryCenter::get_instance()->unpin(AssetKind::GIF, TowerSetting::tower_gif_path[static_cast<int>(type)]);
+}
+
 /**
  * @brief Update attack cooldown and detect if the tower could make an attack.
  * @see Tower::attack(Object *target)
@@ -97,6 +141,17 @@ Tower::update() {
 	}
 }
 
+/**
+ * @brief Advance the animation of a planted tower by one tick.
+ * @details This is not part of update() since some towers override update() to do nothing.
+ */
+void
+Tower::update_animation() {
+	if(!planted) return;
+	DataCenter *DC = DataCenter::get_instance();
+	algif_cursor_advance(&cursor, animation, 1.0 / DC->FPS);
+}
+
 /**
  * @brief Check whether the tower can attack the target. If so, shoot a bullet to the target.
 */
@@ -106,8 +161,8 @@ Tower::attack(Monster *target) {
 	if(!target->get_region().overlap(get_attack_range())) return false;
 	DataCenter *DC = DataCenter::get_instance();
 	SoundCenter *SC = SoundCenter::get_instance();
-	DC->towerBullets.emplace_back(create_bullet());
-	SC->play(TowerSetting::attack_sound_path, ALLEGRO_PLAYMODE_ONCE);
+	create_bullet();
+	SC->play(TowerSetting::attack_sound_path, ALLEGRO_PLAYMODE_ONCE, SoundPriority::LOW);
 	counter = attack_freq;
 	return true;
 }
@@ -121,6 +176,7 @@ Tower::draw() {
 		shape->center_y() - al_get_bitmap_height(bitmap)/2, 0);
 	*/
 	GIFCenter *GIFC = GIFCenter::get_instance();
+	GIFC->resolve(animation, TowerSetting::tower_gif_path[static_cast<int>(type)]);
     //draw gif
     /*algif_draw_gif(animation,
                     shape->center_x() - animation->width/2,
@@ -146,16 +202,19 @@ Tower::draw() {
         // 预览状态：显示动画的第一帧（定格）
         ALLEGRO_BITMAP *first_frame = algif_get_frame_bitmap(animation, 0);
         if (first_frame) {
-            al_draw_bitmap(first_frame, shape->center_x() - al_get_bitmap_width(first_frame) / 2,
-                       shape->center_y() - al_get_bitmap_height(first_frame) / 2,
+            LOD::draw(first_frame, shape->center_x() - LOD::width(first_frame) / 2,
+                       shape->center_y() - LOD::height(first_frame) / 2,
                        0);
         }
     } else {
         // 已放置状态：播放完整动画
-        algif_draw_gif(animation,
-                       shape->center_x() - animation->width / 2,
-                       shape->center_y() - animation->height / 2,
+        ALLEGRO_BITMAP *frame = algif_cursor_bitmap(&cursor, animation);
+        if (frame) {
+            LOD::draw(frame,
+                       shape->center_x() - width / 2,
+                       shape->center_y() - height / 2,
                        0);
+        }
     }
 }
 
@@ -167,8 +226,8 @@ Tower::get_region() const {
 	//revise start
 	//int w = al_get_bitmap_width(bitmap);
 	//int h = al_get_bitmap_height(bitmap);
-	int w = animation->width;
-	int h = animation->height;
+	int w = width;
+	int h = height;
 	//revise end
 	if(type == TowerType::POISON)
 	{
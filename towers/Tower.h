@@ -9,6 +9,7 @@
 #include "../data/GIFCenter.h"
 #include "../algif5/algif.h"
 #include "../monsters/Monster.h"
+#include "../data/ObjectPool.h"
 
 class Bullet;
 
@@ -60,15 +61,30 @@ public:
 	 * @param p center point of the tower.
 	 */
 	static Tower *create_tower(TowerType type, const Point &p);
+	/**
+	 * @brief Create a planted tower of the type in DataCenter::towers.
+	 * @param type the type of a tower.
+	 * @param p center point of the tower.
+	 */
+	static ObjectPool<Tower>::Handle plant_tower(TowerType type, const Point &p);
+	/**
+	 * @brief Size of the largest tower class, which is the slot size of DataCenter::towers.
+	 */
+	static size_t pool_slot_size();
 public:
-	Tower(const Point &p, double attack_range, int attack_freq, TowerType type, int h);
-	virtual ~Tower() {}
+	Tower(const Point &p, double attack_range, double attack_period, TowerType type, int h);
+	virtual ~Tower();
 	virtual void update();
+	void update_animation();
 	virtual bool attack(Monster *target);
 	void draw();
 	Rectangle get_region() const;
 	Rectangle get_attack_range() const;
-	virtual Bullet *create_bullet(/*Object *target*/) = 0;
+	/**
+	 * @brief Shoot a bullet into DataCenter::towerBullets.
+	 * @return Handle of the bullet, or an empty handle if the tower does not shoot.
+	 */
+	virtual ObjectPool<Bullet>::Handle create_bullet(/*Object *target*/) = 0;
 	virtual const double attack_range() const = 0;
 	TowerType type;
 	bool planted = false;
@@ -77,7 +93,7 @@ public:
 private:
 	/**
 	 * @var attack_freq
-	 * @brief Tower attack frequency. This variable will be set by its child classes.
+	 * @brief Tower attack frequency in ticks. This variable is derived from the attack period set by its child classes.
 	 **
 	 * @var counter
 	 * @brief Tower attack cooldown.
@@ -86,6 +102,14 @@ private:
 	int counter;
 	ALLEGRO_BITMAP *bitmap;
 	ALGIF_ANIMATION *animation;
+	/**
+	 * @brief Size of the animation, known even while animation is a placeholder.
+	 */
+	int width, height;
+	/**
+	 * @brief Playback position of this tower in its animation.
+	 */
+	ALGIF_CURSOR cursor;
 };
 
 #endif
@@ -5,16 +5,18 @@
 #include "Tower.h"
 #include "Bullet.h"
 #include "../shapes/Point.h"
+#include "../data/DataCenter.h"
 
 // fixed settings: TowerArcher attributes
 class TowerArcher : public Tower
 {
 public:
-	TowerArcher(const Point &p) : Tower(p, attack_range(), 36, TowerType::ARCHER, 140) {}
-	Bullet *create_bullet(/*Object *target*/) {
+	TowerArcher(const Point &p) : Tower(p, attack_range(), 0.6, TowerType::ARCHER, 140) {}
+	ObjectPool<Bullet>::Handle create_bullet(/*Object *target*/) {
 		const Point &p = Point(shape->center_x(), shape->center_y());
 		//const Point &t = Point(target->shape->center_x(), target->shape->center_y());
-		return new Bullet(p, TowerSetting::tower_bullet_img_path[static_cast<int>(type)], 480, 4, attack_range());
+		DataCenter *DC = DataCenter::get_instance();
+		return DC->towerBullets.emplace(p, TowerSetting::tower_bullet_img_path[static_cast<int>(type)], 480, 4, attack_range());
 		//return new Bullet(p, t, TowerSetting::tower_bullet_img_path[static_cast<int>(type)], 480, 4, attack_range());
 	}
 	const double attack_range() const { return 160; }
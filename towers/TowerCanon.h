@@ -10,7 +10,7 @@
 class TowerCanon : public Tower
 {
 public:
-	TowerCanon(const Point &p) : Tower(p, attack_range(), 120, TowerType::CANON, 420) {}
+	TowerCanon(const Point &p) : Tower(p, attack_range(), 2.0, TowerType::CANON, 420) {}
 	/*Bullet *create_bullet(/*Object *target) {
 		const Point &p = Point(shape->center_x(), shape->center_y());
 		//const Point &t = Point(target->shape->center_x(), target->shape->center_y());
@@ -19,8 +19,8 @@ public:
 	}*/
 	const double attack_range() const { return 200; }
 	void update() override {};
-	Bullet *create_bullet() override {
-        return nullptr;  
+	ObjectPool<Bullet>::Handle create_bullet() override {
+        return {};
     }
 };
 
@@ -10,7 +10,7 @@
 class TowerStorm : public Tower
 {
 public:
-	TowerStorm(const Point &p) : Tower(p, attack_range(), 4, TowerType::STORM, 140) {}
+	TowerStorm(const Point &p) : Tower(p, attack_range(), 1 / 15., TowerType::STORM, 140) {}
 	/*Bullet *create_bullet(/*Object *target) {
 		const Point &p = Point(shape->center_x(), shape->center_y());
 		//const Point &t = Point(target->shape->center_x(), target->shape->center_y());
@@ -19,8 +19,8 @@ public:
 	}*/
 	const double attack_range() const { return 150; }
 	void update() override {};
-	Bullet *create_bullet() override {
-        return nullptr;  
+	ObjectPool<Bullet>::Handle create_bullet() override {
+        return {};
     }
 };
 